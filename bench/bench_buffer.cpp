@@ -0,0 +1,69 @@
+// Measures the cost of inserting and deleting a line at the top of a large
+// file, comparing edit::rowBuffer against the flat std::vector<erow> layout
+// (with per-row line numbers to renumber) that it replaced.
+//
+// usage: bench_buffer [lines] [edits]
+
+#include "edit.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace {
+
+struct legacyRow
+{
+  std::size_t idx;
+  edit::erow r;
+};
+
+double nsPerOp(std::chrono::steady_clock::duration d, std::size_t ops)
+{
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count())
+         / static_cast<double>(ops);
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t lines = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+  std::size_t edits = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+  const std::string line{ "the quick brown fox jumps over the lazy dog" };
+
+  edit::editorConfig E{};
+  for (std::size_t i = 0; i < lines; i++) edit::Insert(E, static_cast<int>(E.numrows), line);
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < edits; i++) edit::Insert(E, 0, line);
+  auto insert_time = std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < edits; i++) edit::Del(E, 0);
+  auto del_time = std::chrono::steady_clock::now() - start;
+
+  std::vector<legacyRow> legacy(lines);
+  for (auto &l : legacy) {
+    l.r.chars = line;
+    l.r.size = line.size();
+  }
+  for (std::size_t i = 0; i < lines; i++) legacy[i].idx = i;
+
+  start = std::chrono::steady_clock::now();
+  for (std::size_t i = 0; i < edits; i++) {
+    legacyRow l{};
+    l.r.chars = line;
+    legacy.insert(legacy.begin(), std::move(l));
+    for (std::size_t j = 1; j < legacy.size(); j++) legacy[j].idx++;
+  }
+  auto legacy_time = std::chrono::steady_clock::now() - start;
+
+  std::printf("lines: %zu, edits: %zu\n", lines, edits);
+  std::printf("rowBuffer insert at line 0: %10.0f ns/op\n", nsPerOp(insert_time, edits));
+  std::printf("rowBuffer delete at line 0: %10.0f ns/op\n", nsPerOp(del_time, edits));
+  std::printf("vector    insert at line 0: %10.0f ns/op\n", nsPerOp(legacy_time, edits));
+  return 0;
+}
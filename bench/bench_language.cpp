@@ -0,0 +1,73 @@
+// Measures the startup cost of language definitions: loading a directory of
+// generated definition files by parsing them, then from the cache they were
+// compiled into, and the lookup of a file's language in the registry.
+//
+// usage: bench_language [languages] [keywords]
+
+#include "language.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace {
+
+double millis(std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+template<typename F> double measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return millis(std::chrono::steady_clock::now() - start);
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 150;
+  std::size_t keywords = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 60;
+
+  auto dir = std::filesystem::temp_directory_path() / "bench_language";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "syntax");
+  auto cache = dir / "syntax.cache";
+  for (std::size_t i = 0; i < count; i++) {
+    std::ofstream out(dir / "syntax" / ("lang" + std::to_string(i) + ".syntax"));
+    out << "# Generated language " << i << "\nname lang" << i << "\nmatch .l" << i << " .lang" << i << " Build" << i
+        << "\n";
+    for (std::size_t k = 0; k < keywords; k += 10) {
+      out << "keywords";
+      for (std::size_t w = k; w < k + 10 && w < keywords; w++) out << " kw" << i << "_" << w << (w % 3 ? "" : "|");
+      out << "\n";
+    }
+    out << "comment //\nmultiline /* */\nhighlight numbers strings\n";
+  }
+  std::printf("%zu languages of %zu keywords\n", count, keywords);
+
+  auto load = [&](const char *label) {
+    syntax::registry languages;
+    std::size_t loaded = 0;
+    auto t = measure([&] { loaded = languages.load(dir / "syntax", cache); });
+    std::printf("  %-22s %8.3f ms  %zu languages%s\n", label, t, loaded, languages.cached() ? ", cached" : "");
+  };
+  load("parsed, cache written");
+  load("from the cache");
+  load("from the cache again");
+
+  syntax::registry languages;
+  languages.load(dir / "syntax", cache);
+  std::size_t rounds = 1000000, found = 0;
+  auto t = measure([&] {
+    for (std::size_t r = 0; r < rounds; r++) {
+      found += languages.find("src/module/file" + std::to_string(r % count) + ".l" + std::to_string(r % count)) != nullptr;
+    }
+  });
+  std::printf("  find                   %8.1f ns per file name  (%zu found)\n", t * 1e6 / static_cast<double>(rounds), found);
+
+  std::filesystem::remove_all(dir);
+  return 0;
+}
@@ -0,0 +1,81 @@
+// Compares line splitting throughput of the getline loop that edit::Open used
+// to have against the newline scanners behind edit::IndexLines.
+//
+// usage: bench_lineindex [megabytes] [file]
+
+#include "lineindex.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+double gbPerSecond(std::size_t bytes, std::chrono::steady_clock::duration d)
+{
+  return static_cast<double>(bytes) / std::chrono::duration<double>(d).count() / 1e9;
+}
+
+template<typename F> double measure(std::size_t bytes, F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return gbPerSecond(bytes, std::chrono::steady_clock::now() - start);
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+  std::string text;
+  if (argc > 2) {
+    std::ifstream f(argv[2], std::ios::binary);
+    text.assign(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+  } else {
+    const std::string line{ "2024-01-01 12:00:00.000 INFO  [main] request handled in 12ms status=200\n" };
+    while (text.size() < megabytes << 20) text += line;
+  }
+
+  std::size_t lines = 0;
+  auto getline = measure(text.size(), [&] {
+    std::istringstream in(text);
+    std::string line;
+    while (std::getline(in, line)) {
+      std::size_t linelen = line.size();
+      while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r')) linelen--;
+      lines++;
+    }
+  });
+  std::printf("%zu bytes, %zu lines\n", text.size(), lines);
+  std::printf("getline   %6.2f GB/s\n", getline);
+
+  const std::pair<edit::scanner, const char *> scanners[] = {
+    { edit::scanner::scalar, "scalar" },
+    { edit::scanner::sse2, "sse2" },
+    { edit::scanner::avx2, "avx2" },
+  };
+  std::vector<std::size_t> found;
+  found.reserve(lines + 1);
+  for (const auto &[s, name] : scanners) {
+    if (!edit::ScannerSupported(s)) {
+      std::printf("%-9s unsupported\n", name);
+      continue;
+    }
+    found.clear();
+    std::printf("%-9s %6.2f GB/s\n", name, measure(text.size(), [&] {
+      edit::ScanNewlines(text.data(), text.size(), 0, found, s);
+    }));
+  }
+
+  std::printf("index     %6.2f GB/s\n", measure(text.size(), [&] {
+    auto index = edit::IndexLines(text.data(), text.size());
+    lines = index.lines();
+  }));
+  return 0;
+}
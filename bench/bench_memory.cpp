@@ -0,0 +1,66 @@
+// Measures the memory taken by the rows of a highlighted buffer and the time
+// of a full pass over them, as a search or a save would make.
+//
+// usage: bench_memory [lines] [length]
+
+#include "edit.h"
+#include "syntax.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <unistd.h>
+
+namespace {
+
+std::size_t residentBytes()
+{
+  long pages = 0;
+  long resident = 0;
+  if (FILE *f = std::fopen("/proc/self/statm", "r")) {
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) resident = 0;
+    std::fclose(f);
+  }
+  return static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t lines = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  std::size_t length = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 40;
+
+  auto before = residentBytes();
+  edit::editorConfig E{};
+  E.screenrows = 50;
+  for (std::size_t i = 0; i < lines; i++) {
+    // Like most source files, only some lines are indented with tabs
+    std::string s = (i % 4 == 0 ? "\tx = " : "  x = ") + std::to_string(i) + "; /* n */";
+    while (s.size() < length) s += 'a';
+    edit::Insert(E, static_cast<int>(E.numrows), s);
+  }
+  E.filename = "bench.c";
+  syntax::SelectHighlight(E);
+  auto after = residentBytes();
+
+  auto t0 = std::chrono::steady_clock::now();
+  std::size_t sum = 0;
+  for (std::size_t i = 0; i < E.numrows; i++) {
+    const auto &r = E.row[i];
+    auto render = r.render();
+    for (std::size_t j = 0; j < r.rsize; j++) sum += static_cast<unsigned char>(render[j]);
+    for (const auto &s : r.highlight()) sum += s.hl * s.length;
+  }
+  auto t = std::chrono::steady_clock::now() - t0;
+
+  std::printf("%zu lines of %zu chars: %.1f bytes/line resident, scan %.2f ms (%zu)\n",
+    lines,
+    length,
+    static_cast<double>(after - before) / static_cast<double>(lines),
+    std::chrono::duration<double, std::milli>(t).count(),
+    sum);
+  return 0;
+}
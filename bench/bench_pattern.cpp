@@ -0,0 +1,133 @@
+// Measures regex search against literal search over a log: a search::pattern
+// on its own, row by row, then search::matchIndex over rows in memory and in
+// a mapped file, for a literal query and for regular expressions with and
+// without a literal the rows can be filtered on first. std::regex is timed
+// on a sample of the rows for comparison.
+//
+// usage: bench_pattern [megabytes] [regex...]
+
+#include "pattern.h"
+#include "search.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+double millis(std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+template<typename F> double measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return millis(std::chrono::steady_clock::now() - start);
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+  std::vector<std::string> regexes;
+  for (int i = 2; i < argc; i++) regexes.emplace_back(argv[i]);
+  if (regexes.empty()) regexes = { "status=503", "status=50\\d$", "handled in \\d+ms", "request \\d*7 ", "\\d\\d:\\d\\d" };
+
+  edit::rowBuffer rows;
+  std::vector<std::string> lines;
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; bytes < megabytes << 20; i++) {
+    std::string line = "2024-01-01 12:00:00.000 INFO  [main] request " + std::to_string(i) + " handled in "
+                       + std::to_string(i % 97) + "ms status=" + std::to_string(200 + i % 307);
+    bytes += line.size() + 1;
+    edit::erow r;
+    r.chars = line;
+    r.size = line.size();
+    rows.insert(rows.size(), std::move(r));
+    lines.push_back(std::move(line));
+  }
+  std::printf("%zu bytes, %zu lines\n", bytes, lines.size());
+  auto rate = [&](double ms, std::size_t n) { return static_cast<double>(n) / ms / 1e3; };
+
+  // One thread, every row through the DFA, no literal filter
+  std::printf("pattern::find, every row\n");
+  std::vector<std::pair<std::size_t, std::size_t>> spans;
+  for (const auto &r : regexes) {
+    search::pattern p(r);
+    std::size_t found = 0;
+    auto t = measure([&] {
+      for (const auto &line : lines) {
+        spans.clear();
+        p.find(line, spans);
+        found += spans.size();
+      }
+    });
+    std::printf("  %-20s %8.1f ms  %7.1f MB/s  %zu matches, %zu states, literal \"%s\"\n",
+      r.c_str(),
+      t,
+      rate(t, bytes),
+      found,
+      p.states(),
+      p.required().c_str());
+  }
+
+  // std::regex backtracks and is slow enough that a sample will do
+  std::size_t sample = std::min<std::size_t>(lines.size(), 100000);
+  std::size_t sampleBytes = 0;
+  for (std::size_t i = 0; i < sample; i++) sampleBytes += lines[i].size() + 1;
+  std::printf("std::regex, first %zu rows\n", sample);
+  for (const auto &r : regexes) {
+    std::regex re(r, std::regex::ECMAScript | std::regex::multiline);
+    std::size_t found = 0;
+    auto t = measure([&] {
+      for (std::size_t i = 0; i < sample; i++) {
+        found += static_cast<std::size_t>(
+          std::distance(std::sregex_iterator(lines[i].begin(), lines[i].end(), re), std::sregex_iterator()));
+      }
+    });
+    std::printf("  %-20s %8.1f ms  %7.1f MB/s  %zu matches\n", r.c_str(), t, rate(t, sampleBytes), found);
+  }
+
+  // The whole search as Find runs it: the literal query first, then each
+  // regex, filtered on its literal and spread over the thread pool
+  auto searching = [&](const edit::rowBuffer &buffer, const char *label) {
+    std::printf("matchIndex, %s\n", label);
+    auto one = [&](const std::string &q, bool regex) {
+      search::matchIndex index;
+      auto t = measure([&] {
+        index.update(buffer, q, regex);
+        index.wait(std::chrono::hours(1));
+      });
+      std::printf("  %-7s %-20s %8.1f ms  %7.1f MB/s  %zu matches%s\n",
+        regex ? "regex" : "literal",
+        q.c_str(),
+        t,
+        rate(t, bytes),
+        index.matches().size(),
+        index.complete() ? "" : "+");
+    };
+    one("status=503", false);
+    for (const auto &r : regexes) one(r, true);
+  };
+  searching(rows, "rows in memory");
+
+  auto path = std::filesystem::temp_directory_path() / "bench_pattern.log";
+  {
+    std::ofstream out(path, std::ios::binary);
+    for (const auto &line : lines) out << line << '\n';
+  }
+  edit::rowBuffer mapped;
+  mapped.attach(std::make_shared<const edit::mappedFile>(path.c_str()));
+  mapped.wait();
+  mapped.adopt();
+  searching(mapped, "rows in a mapped file");
+  std::filesystem::remove(path);
+  return 0;
+}
@@ -0,0 +1,83 @@
+// Measures a full-screen redraw of highlighted C code: the time per frame and
+// the number of heap allocations made while drawing it. Every frame is
+// forced to be drawn whole with tui::Repaint().
+//
+// usage: bench_render [cols] [rows] [frames]
+
+#include "edit.h"
+#include "syntax.h"
+#include "tui.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+
+namespace {
+
+std::atomic<std::size_t> allocations{ 0 };
+
+}// namespace
+
+void *operator new(std::size_t n)
+{
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void *p = std::malloc(n ? n : 1)) return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept { std::free(p); }
+void operator delete(void *p, std::size_t) noexcept { std::free(p); }
+
+int main(int argc, char *argv[])
+{
+  int cols = argc > 1 ? std::atoi(argv[1]) : 200;
+  int rows = argc > 2 ? std::atoi(argv[2]) : 60;
+  std::size_t frames = argc > 3 ? std::strtoull(argv[3], nullptr, 10) : 2000;
+
+  edit::editorConfig E{};
+  E.screencols = cols;
+  E.screenrows = rows - 2;
+  const char *text[] = {
+    "  for (int i = 0; i < count; i++) { /* walk the table */",
+    "    if (table[i].key == \"needle\") return table[i].value + 0x1f;",
+    "    // a line comment that runs on for a while to fill the screen width",
+    "    char c = 'q'; double d = 3.25; unsigned long mask = ~0ul; switch (c) { default: break; }",
+  };
+  for (std::size_t i = 0; i < static_cast<std::size_t>(rows) * 4; i++) {
+    std::string s = text[i % 4];
+    while (s.size() < static_cast<std::size_t>(cols)) s += " x += y;";
+    edit::Insert(E, static_cast<int>(E.numrows), s);
+  }
+  E.filename = "bench.c";
+  syntax::SelectHighlight(E);
+
+  std::string ab;
+  ab.reserve(64 * 1024);
+  tui::Repaint();
+  tui::RefreshScreen(E, ab);// warm up the frames and the output buffer
+
+  std::size_t bytes = 0;
+  auto before = allocations.load();
+  auto t0 = std::chrono::steady_clock::now();
+  for (std::size_t f = 0; f < frames; f++) {
+    E.rowoff = f % static_cast<std::size_t>(rows);
+    tui::Repaint();
+    tui::RefreshScreen(E, ab);
+    bytes += ab.size();
+  }
+  auto t = std::chrono::steady_clock::now() - t0;
+  auto allocs = allocations.load() - before;
+
+  auto ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count());
+  std::printf("%dx%d, %zu frames: %.0f ns/frame, %.0f bytes/frame, %.2f allocations/frame\n",
+    cols,
+    rows,
+    frames,
+    ns / static_cast<double>(frames),
+    static_cast<double>(bytes) / static_cast<double>(frames),
+    static_cast<double>(allocs) / static_cast<double>(frames));
+  return 0;
+}
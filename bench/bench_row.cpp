@@ -0,0 +1,76 @@
+// Measures moving the cursor across a long, tab-heavy line: every step
+// converts the cursor column as edit::Scroll() does, and the sweep back
+// converts render columns as the search does. The row functions are
+// compared against the scans from the start of the row they replaced.
+//
+// usage: bench_row [length]
+
+#include "edit.h"
+#include "row.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+const std::size_t TAB_STOP{ 8 };
+
+std::size_t legacyCxToRx(const edit::erow &r, const std::size_t cx)
+{
+  std::size_t rx = 0;
+  for (std::size_t j = 0; j < cx; j++) {
+    if (r.chars.at(j) == '\t') rx += (TAB_STOP - 1) - (rx % TAB_STOP);
+    rx++;
+  }
+  return rx;
+}
+
+std::size_t legacyRxToCx(const edit::erow &r, const std::size_t rx)
+{
+  std::size_t cur_rx = 0;
+  std::size_t cx = 0;
+  for (cx = 0; cx < r.size; cx++) {
+    if (r.chars.at(cx) == '\t') cur_rx += (TAB_STOP - 1) - (cur_rx % TAB_STOP);
+    cur_rx++;
+    if (cur_rx > rx) return cx;
+  }
+  return cx;
+}
+
+template<typename ToRx, typename ToCx> double sweep(const edit::erow &r, ToRx toRx, ToCx toCx, std::size_t &check)
+{
+  auto t0 = std::chrono::steady_clock::now();
+  for (std::size_t cx = 0; cx <= r.size; cx++) check += toRx(r, cx);
+  for (std::size_t rx = r.rsize; rx-- > 0;) check += toCx(r, rx);
+  auto t = std::chrono::steady_clock::now() - t0;
+  return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(t).count())
+         / static_cast<double>(r.size + 1 + r.rsize);
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t length = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 50000;
+
+  edit::erow r;
+  while (r.chars.size() < length) r.chars += "\tkey\t= value;\t\t// note ";
+  r.chars.resize(length);
+  r.size = r.chars.size();
+  row::Update(r);
+
+  std::size_t a = 0, b = 0;
+  double legacy = sweep(r, legacyCxToRx, legacyRxToCx, a);
+  double indexed = sweep(r, row::CxToRx, row::RxToCx, b);
+
+  std::printf("%zu chars, %zu columns\n", r.size, r.rsize);
+  std::printf("  scan   %12.1f ns/conversion\n", legacy);
+  std::printf("  index  %12.1f ns/conversion\n", indexed);
+  if (a != b) {
+    std::printf("results differ!\n");
+    return 1;
+  }
+  return 0;
+}
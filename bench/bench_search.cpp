@@ -0,0 +1,128 @@
+// Measures find-as-you-type over a log: std::string::find on every row for
+// each keystroke of the query, as tui::FindCallback used to, against
+// search::Scan and search::matchIndex, which narrows the matches of the
+// previous keystroke instead of searching again.
+//
+// usage: bench_search [megabytes] [query]
+
+#include "search.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace {
+
+double millis(std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+template<typename F> double measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return millis(std::chrono::steady_clock::now() - start);
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 256;
+  std::string query = argc > 2 ? argv[2] : "status=503";
+
+  edit::rowBuffer rows;
+  std::vector<std::string> lines;
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; bytes < megabytes << 20; i++) {
+    std::string line = "2024-01-01 12:00:00.000 INFO  [main] request " + std::to_string(i) + " handled in "
+                       + std::to_string(i % 97) + "ms status=" + std::to_string(200 + i % 307);
+    bytes += line.size() + 1;
+    edit::erow r;
+    r.chars = line;
+    r.size = line.size();
+    rows.insert(rows.size(), std::move(r));
+    lines.push_back(std::move(line));
+  }
+  std::printf("%zu bytes, %zu lines, query \"%s\"\n", bytes, lines.size(), query.c_str());
+
+  // Every prefix of the query, as it is typed
+  std::size_t found = 0;
+  auto find = measure([&] {
+    for (std::size_t n = 1; n <= query.size(); n++) {
+      found = 0;
+      for (const auto &line : lines) found += line.find(query.data(), 0, n) != std::string::npos;
+    }
+  });
+  std::printf("string::find   %8.1f ms  %zu rows (first match only)\n", find, found);
+
+  const std::pair<edit::scanner, const char *> scanners[] = {
+    { edit::scanner::scalar, "scalar" },
+    { edit::scanner::sse2, "sse2" },
+    { edit::scanner::avx2, "avx2" },
+  };
+  std::vector<std::size_t> hits;
+  for (const auto &[s, name] : scanners) {
+    if (!edit::ScannerSupported(s)) continue;
+    auto t = measure([&] {
+      for (std::size_t n = 1; n <= query.size(); n++) {
+        found = 0;
+        for (const auto &line : lines) {
+          hits.clear();
+          search::Scan(line, std::string_view(query).substr(0, n), hits, s);
+          found += hits.size();
+        }
+      }
+    });
+    std::printf("Scan %-9s %8.1f ms  %zu matches\n", name, t, found);
+  }
+
+  std::string text;
+  text.reserve(bytes);
+  for (const auto &line : lines) (text += line) += '\n';
+  for (const auto &[s, name] : scanners) {
+    if (!edit::ScannerSupported(s)) continue;
+    hits.clear();
+    auto t = measure([&] { search::Scan(text, query, hits, s); });
+    std::printf("Scan %-9s %8.1f ms  %6.2f GB/s over the text in one piece\n", name, t, static_cast<double>(bytes) / t / 1e6);
+  }
+  text = std::string();
+
+  // The matches as each keystroke narrows them, in rows held in memory and
+  // in rows still in a mapped file, as a large log is after edit::Open
+  auto typing = [&](const edit::rowBuffer &buffer, const char *label) {
+    search::matchIndex index;
+    double total = 0;
+    std::printf("matchIndex, %s\n", label);
+    for (std::size_t n = 1; n <= query.size(); n++) {
+      auto t = measure([&] {
+        index.update(buffer, std::string_view(query).substr(0, n));
+        index.wait(std::chrono::hours(1));
+      });
+      total += t;
+      std::printf("  %-12s %8.2f ms  %zu matches%s\n",
+        query.substr(0, n).c_str(),
+        t,
+        index.matches().size(),
+        index.complete() ? "" : "+");
+    }
+    std::printf("  total        %8.2f ms\n", total);
+  };
+  typing(rows, "rows in memory");
+
+  auto path = std::filesystem::temp_directory_path() / "bench_search.log";
+  {
+    std::ofstream out(path, std::ios::binary);
+    for (const auto &line : lines) out << line << '\n';
+  }
+  edit::rowBuffer mapped;
+  mapped.attach(std::make_shared<const edit::mappedFile>(path.c_str()));
+  mapped.wait();
+  mapped.adopt();
+  typing(mapped, "rows in a mapped file");
+  std::filesystem::remove(path);
+  return 0;
+}
@@ -0,0 +1,134 @@
+// Measures syntax highlighting throughput in MB/s over generated C code, with
+// the C keywords and with a list of hundreds of keywords, and the keyword
+// lookup alone: syntax::keywordTable against trying every keyword in turn
+// with strncmp, as syntax::Highlight() used to.
+//
+// usage: bench_syntax [megabytes] [keywords]
+
+#include "edit.h"
+#include "lexer.h"
+#include "syntax.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+double millis(std::chrono::steady_clock::duration d) { return std::chrono::duration<double, std::milli>(d).count(); }
+
+template<typename F> double measure(F f)
+{
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return millis(std::chrono::steady_clock::now() - start);
+}
+
+bool separator(char c) { return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != nullptr; }
+
+// The keyword matching syntax::Highlight() did before keywordTable
+unsigned char linear(const char **keywords, const char *text)
+{
+  for (int j = 0; keywords[j]; j++) {
+    auto klen = strlen(keywords[j]);
+    auto kw2 = keywords[j][klen - 1] == '|';
+    if (kw2) klen--;
+    if (!strncmp(text, keywords[j], klen) && separator(text[klen])) return kw2 ? syntax::HL_KEYWORD2 : syntax::HL_KEYWORD1;
+  }
+  return syntax::HL_NORMAL;
+}
+
+}// namespace
+
+int main(int argc, char *argv[])
+{
+  std::size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+  std::size_t many = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 500;
+
+  const char *lines[] = {
+    "static int count_items(struct list *head, unsigned long limit) {",
+    "  for (int i = 0; i < limit && head != NULL; i++) head = head->next;",
+    "  if (value_of(head) > 3.25) return compute(head, \"label\", 'x');",
+    "  /* a comment with words like while and return in it */",
+    "  switch (kind) { case KIND_A: break; default: continue; }",
+    "  double ratio = (double)total / (float)(samples + 1);  // average",
+  };
+  edit::editorConfig E{};
+  std::size_t bytes = 0;
+  for (std::size_t i = 0; bytes < megabytes << 20; i++) {
+    std::string_view line = lines[i % std::size(lines)];
+    edit::Insert(E, static_cast<int>(E.numrows), line);
+    bytes += line.size() + 1;
+  }
+  std::printf("%zu bytes, %zu lines\n", bytes, E.numrows);
+
+  // The C keywords, and as many more as asked for, made up but shaped like
+  // the identifiers in the text
+  E.filename = "bench.c";
+  syntax::SelectHighlight(E);
+  auto *c = E.syntax;
+  std::vector<std::string> words;
+  for (auto **k = c->keywords; *k; k++) words.emplace_back(*k);
+  for (std::size_t i = 0; words.size() < many; i++) words.push_back("name_" + std::to_string(i) + (i % 2 ? "|" : ""));
+  std::vector<const char *> list;
+  for (const auto &w : words) list.push_back(w.c_str());
+  list.push_back(nullptr);
+  edit::editorSyntax big = *c;
+  big.keywords = list.data();
+  big.lexer = nullptr;
+  syntax::Compile(big);
+
+  for (auto *s : { c, &big }) {
+    std::size_t n = 0;
+    for (auto **k = s->keywords; *k; k++) n++;
+    E.syntax = s;
+    std::size_t rounds = 5;
+    auto t = measure([&] {
+      for (std::size_t r = 0; r < rounds; r++) syntax::HighlightAll(E);
+    });
+    std::printf("HighlightAll, %4zu keywords  %8.1f ms  %7.1f MB/s\n",
+      n,
+      t / static_cast<double>(rounds),
+      static_cast<double>(bytes * rounds) / t / 1e3);
+  }
+
+  // Keyword lookups at the start of every token, as Highlight() makes them
+  std::vector<const char *> tokens;
+  for (const auto *line : lines) {
+    bool prev = true;
+    for (const char *p = line; *p; p++) {
+      if (prev) tokens.push_back(p);
+      prev = separator(*p);
+    }
+  }
+  std::size_t rounds = (megabytes << 20) / 400;
+  for (auto *s : { c, &big }) {
+    std::size_t n = 0, found = 0;
+    for (auto **k = s->keywords; *k; k++) n++;
+    auto tl = measure([&] {
+      for (std::size_t r = 0; r < rounds; r++) {
+        for (const auto *p : tokens) found += linear(s->keywords, p) != syntax::HL_NORMAL;
+      }
+    });
+    auto tt = measure([&] {
+      for (std::size_t r = 0; r < rounds; r++) {
+        for (const auto *p : tokens) {
+          auto end = p;
+          while (!separator(*end)) end++;
+          found += s->lexer->keywords().find(std::string_view(p, static_cast<std::size_t>(end - p))) != syntax::HL_NORMAL;
+        }
+      }
+    });
+    auto lookups = static_cast<double>(rounds * tokens.size());
+    std::printf("lookups, %4zu keywords: strncmp %7.1f ns, keywordTable %5.1f ns per token  (%zu found)\n",
+      n,
+      tl * 1e6 / lookups,
+      tt * 1e6 / lookups,
+      found);
+  }
+  return 0;
+}
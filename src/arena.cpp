@@ -0,0 +1,269 @@
+#include "arena.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include <sys/mman.h>
+
+namespace edit {
+
+// The header at the start of every slab. Slabs are aligned to their size, so
+// the slab of a block is found from its address alone.
+struct rowArena::slab
+{
+  rowArena *owner;
+  slab *prev;// in the owner's open or full list of the class
+  slab *next;
+  std::size_t size;// of its blocks
+  std::size_t live;// blocks handed out that the owner hasn't had back
+  char *top;// blocks from here on were never handed out
+  void *free;// blocks freed by the owner's thread
+  std::atomic<void *> remote;// blocks freed by other threads
+  bool isOpen;
+};
+
+namespace {
+
+  thread_local rowArena *current = nullptr;
+  // Set once the thread has given its arena up
+  thread_local bool ended = false;
+
+  // Arenas whose thread ended, for the next thread to take
+  struct orphanage
+  {
+    std::mutex mutex{};
+    std::vector<rowArena *> arenas{};
+  };
+
+  orphanage &Orphans()
+  {
+    static auto *orphans = new orphanage;
+    return *orphans;
+  }
+
+  // Gives the arena of a thread up when the thread ends
+  struct farewell
+  {
+    ~farewell()
+    {
+      if (!current) return;
+      current->trim();
+      auto &orphans = Orphans();
+      std::lock_guard<std::mutex> lock(orphans.mutex);
+      orphans.arenas.push_back(current);
+      current = nullptr;
+      ended = true;
+    }
+  };
+
+  // Rows made by threads that have ended, from the destructors of their
+  // thread_locals. None of them owns it, so every block freed into it is a
+  // remote free.
+  struct lastArena
+  {
+    std::mutex mutex{};
+    rowArena arena{};
+  };
+
+  lastArena &Last()
+  {
+    static auto *last = new lastArena;
+    return *last;
+  }
+
+  void *&nextOf(void *p) { return *static_cast<void **>(p); }
+
+}// namespace
+
+rowArena::~rowArena()
+{
+  for (auto *lists : { &open, &full }) {
+    for (auto *s : *lists) {
+      while (s) {
+        auto *next = s->next;
+        munmap(s, SLAB);
+        s = next;
+      }
+    }
+  }
+}
+
+bool rowArena::hasRoom(const slab *s) const
+{
+  return s->free || static_cast<std::size_t>(reinterpret_cast<const char *>(s) + SLAB - s->top) >= s->size;
+}
+
+void rowArena::link(slab *s)
+{
+  auto &head = (s->isOpen ? open : full)[s->size / GRAIN - 1];
+  s->prev = nullptr;
+  s->next = head;
+  if (head) head->prev = s;
+  head = s;
+}
+
+void rowArena::unlink(slab *s)
+{
+  auto &head = (s->isOpen ? open : full)[s->size / GRAIN - 1];
+  if (s->prev) s->prev->next = s->next;
+  if (s->next) s->next->prev = s->prev;
+  if (head == s) head = s->next;
+}
+
+void rowArena::release(slab *s)
+{
+  unlink(s);
+  munmap(s, SLAB);
+  count--;
+}
+
+void rowArena::drain(slab *s)
+{
+  auto *p = s->remote.exchange(nullptr, std::memory_order_acquire);
+  while (p) {
+    auto *next = nextOf(p);
+    nextOf(p) = s->free;
+    s->free = p;
+    s->live--;
+    p = next;
+  }
+}
+
+rowArena::slab *rowArena::refill(std::size_t c)
+{
+  // Slabs that ran full may have had blocks freed into them since, which
+  // other threads count
+  for (auto *s = remoteFrees[c].exchange(0, std::memory_order_acquire) ? full[c] : nullptr; s;) {
+    auto *next = s->next;
+    drain(s);
+    if (s->live == 0) {
+      release(s);
+    } else if (s->free) {
+      unlink(s);
+      s->isOpen = true;
+      link(s);
+    }
+    s = next;
+  }
+  if (open[c]) return open[c];
+
+  // Twice the size, so that a slab aligned to it fits in somewhere
+  auto *mapped = static_cast<char *>(mmap(nullptr, 2 * SLAB, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0));
+  if (mapped == MAP_FAILED) throw std::bad_alloc();
+  auto skip = (SLAB - reinterpret_cast<std::uintptr_t>(mapped) % SLAB) % SLAB;
+  if (skip) munmap(mapped, skip);
+  munmap(mapped + skip + SLAB, SLAB - skip);
+
+  auto size = (c + 1) * GRAIN;
+  static_assert(sizeof(slab) <= HEADER);
+  auto *s = new (mapped + skip) slab{ this, nullptr, nullptr, size, 0, mapped + skip + HEADER, nullptr, {}, true };
+  link(s);
+  count++;
+  return s;
+}
+
+void *rowArena::take(std::size_t c)
+{
+  auto *s = open[c] ? open[c] : refill(c);
+  void *p;
+  if (s->free) {
+    p = s->free;
+    s->free = nextOf(p);
+  } else {
+    p = s->top;
+    s->top += s->size;
+  }
+  s->live++;
+  if (!hasRoom(s)) {
+    unlink(s);
+    s->isOpen = false;
+    link(s);
+  }
+  return p;
+}
+
+void *rowArena::allocate(std::size_t n)
+{
+  if (n == 0) n = 1;
+  if (n > MAX_SMALL) return ::operator new(n);
+
+  auto c = (n + GRAIN - 1) / GRAIN - 1;
+  if (!ended) return RowArena().take(c);
+  auto &last = Last();
+  std::lock_guard<std::mutex> lock(last.mutex);
+  return last.arena.take(c);
+}
+
+void rowArena::deallocate(void *p, std::size_t n)
+{
+  if (!p) return;
+  if (n == 0) n = 1;
+  if (n > MAX_SMALL) {
+    ::operator delete(p);
+    return;
+  }
+
+  auto *s = reinterpret_cast<slab *>(reinterpret_cast<std::uintptr_t>(p) / SLAB * SLAB);
+  // A thread that has ended has no arena, and all it frees is remote
+  if (s->owner == current) {
+    current->give(s, p);
+    return;
+  }
+  // Once the block is pushed, the owner may take it and unmap the slab
+  auto &frees = s->owner->remoteFrees[s->size / GRAIN - 1];
+  auto *head = s->remote.load(std::memory_order_relaxed);
+  do {
+    nextOf(p) = head;
+  } while (!s->remote.compare_exchange_weak(head, p, std::memory_order_release, std::memory_order_relaxed));
+  frees.fetch_add(1, std::memory_order_release);
+}
+
+void rowArena::give(slab *s, void *p)
+{
+  nextOf(p) = s->free;
+  s->free = p;
+  s->live--;
+  if (!s->isOpen) {
+    unlink(s);
+    s->isOpen = true;
+    link(s);
+  }
+  // The last slab of a class is kept, so that a row that is freed and made
+  // again doesn't map and unmap a slab each time
+  if (s->live == 0 && (s->prev || s->next)) release(s);
+}
+
+void rowArena::trim()
+{
+  for (auto *lists : { &open, &full }) {
+    for (auto *s : *lists) {
+      while (s) {
+        auto *next = s->next;
+        drain(s);
+        if (s->live == 0) release(s);
+        s = next;
+      }
+    }
+  }
+}
+
+rowArena &RowArena()
+{
+  if (!current) {
+    thread_local farewell goodbye;
+    auto &orphans = Orphans();
+    std::lock_guard<std::mutex> lock(orphans.mutex);
+    if (orphans.arenas.empty()) {
+      current = new rowArena;
+    } else {
+      current = orphans.arenas.back();
+      orphans.arenas.pop_back();
+    }
+  }
+  return *current;
+}
+
+}// end namespace edit
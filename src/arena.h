@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+namespace edit {
+
+// Hands out the bytes of rows (chars, render and highlighting) from 64 KiB
+// slabs, each cut into blocks of one size class; classes are 8 bytes apart.
+// Unlike malloc it keeps no header per block, and rows created one after the
+// other end up next to each other. Blocks are never moved to compact slabs,
+// so a slab stays mapped for as long as one of its blocks is in use.
+//
+// Every thread allocates from an arena of its own, without locking. A block
+// freed on the thread that allocated it goes on its slab's free list; one
+// freed on another thread is pushed onto the slab's list of remote frees,
+// which the owning thread takes over when it runs out of room. A slab whose
+// blocks have all come back is unmapped. When a thread ends, its arena is
+// kept with the rows still in it, and handed to the next thread that starts
+// allocating. Rows the thread still frees after that, from the destructors
+// of its thread_locals, go back as remote frees; rows it still makes come
+// from an arena shared, under a lock, by all threads past their end.
+class rowArena
+{
+public:
+  rowArena() = default;
+  ~rowArena();
+
+  rowArena(const rowArena &) = delete;
+  rowArena &operator=(const rowArena &) = delete;
+
+  // From the arena of the calling thread
+  static void *allocate(std::size_t n);
+  // n must be the size the block was allocated with. The block may come from
+  // the arena of any thread.
+  static void deallocate(void *p, std::size_t n);
+
+  // Takes over the blocks other threads freed and unmaps the slabs left empty
+  void trim();
+  // Slabs held, empty or not
+  std::size_t slabs() const { return count; }
+
+private:
+  static constexpr std::size_t GRAIN{ 8 };
+  static constexpr std::size_t MAX_SMALL{ 512 };
+  static constexpr std::size_t SLAB{ 64 << 10 };
+  static constexpr std::size_t CLASSES{ MAX_SMALL / GRAIN };
+  // Bytes at the start of a slab taken by its header
+  static constexpr std::size_t HEADER{ 128 };
+
+  struct slab;
+
+  void *take(std::size_t c);
+  void give(slab *s, void *p);
+  // A slab with room for the class, from those other threads freed into
+  // or a new one
+  slab *refill(std::size_t c);
+  // Moves the remote frees of a slab onto its free list
+  void drain(slab *s);
+  bool hasRoom(const slab *s) const;
+  void link(slab *s);
+  void unlink(slab *s);
+  void release(slab *s);
+
+  // Per class, the slabs with blocks to hand out, and those without
+  std::array<slab *, CLASSES> open{};
+  std::array<slab *, CLASSES> full{};
+  std::size_t count{};
+  // Per class, blocks other threads freed since refill() last looked
+  std::array<std::atomic<std::size_t>, CLASSES> remoteFrees{};
+};
+
+// The arena of the calling thread, which mustn't have ended yet. Arenas are
+// never destroyed, so that rows outliving their thread, or the program's
+// statics at exit, are still safe to free.
+rowArena &RowArena();
+
+template<typename T> struct arenaAllocator
+{
+  using value_type = T;
+
+  arenaAllocator() = default;
+  template<typename U> arenaAllocator(const arenaAllocator<U> &) {}
+
+  T *allocate(std::size_t n) { return static_cast<T *>(rowArena::allocate(n * sizeof(T))); }
+  void deallocate(T *p, std::size_t n) { rowArena::deallocate(p, n * sizeof(T)); }
+
+  template<typename U> bool operator==(const arenaAllocator<U> &) const { return true; }
+};
+
+using rowString = std::basic_string<char, std::char_traits<char>, arenaAllocator<char>>;
+
+// Rows compare equal to any other string with the same characters
+inline bool operator==(const rowString &a, std::string_view b) { return std::string_view(a) == b; }
+
+}// end namespace edit
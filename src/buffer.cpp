@@ -0,0 +1,317 @@
+#include "buffer.h"
+#include "row.h"
+
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <limits>
+#include <tuple>
+#include <utility>
+
+namespace edit {
+
+// A chunk is split in two once it grows past this many rows
+const std::size_t CHUNK_MAX{ 512 };
+
+/*** rows ***/
+
+erow::erow(const erow &o)
+  : size(o.size), rsize(o.rsize), chars(o.chars), expanded(o.expanded), hl_open_comment(o.hl_open_comment)
+{
+  highlight(o.highlight());
+}
+
+erow::erow(erow &&o) noexcept
+  : size(o.size), rsize(o.rsize), chars(std::move(o.chars)), expanded(std::move(o.expanded)),
+    hl(std::exchange(o.hl, nullptr)), hl_count(std::exchange(o.hl_count, 0)), hl_open_comment(o.hl_open_comment),
+    tabs(std::move(o.tabs))
+{}
+
+erow &erow::operator=(erow &&o) noexcept
+{
+  if (this == &o) return *this;
+  rowArena::deallocate(hl, hl_count * sizeof(hlSpan));
+  size = o.size;
+  rsize = o.rsize;
+  chars = std::move(o.chars);
+  expanded = std::move(o.expanded);
+  hl = std::exchange(o.hl, nullptr);
+  hl_count = std::exchange(o.hl_count, 0);
+  hl_open_comment = o.hl_open_comment;
+  tabs = std::move(o.tabs);
+  return *this;
+}
+
+erow::~erow() { rowArena::deallocate(hl, hl_count * sizeof(hlSpan)); }
+
+void erow::highlight(std::span<const hlSpan> spans)
+{
+  if (spans.size() != hl_count) {
+    rowArena::deallocate(hl, hl_count * sizeof(hlSpan));
+    hl_count = static_cast<std::uint32_t>(spans.size());
+    hl = hl_count ? static_cast<hlSpan *>(rowArena::allocate(hl_count * sizeof(hlSpan))) : nullptr;
+  }
+  std::copy(spans.begin(), spans.end(), hl);
+}
+
+unsigned char erow::highlightAt(std::size_t rx) const
+{
+  auto spans = highlight();
+  auto it = std::partition_point(spans.begin(), spans.end(), [&](const hlSpan &s) { return s.start + s.length <= rx; });
+  return it != spans.end() && it->start <= rx ? it->hl : 0;
+}
+
+/*** lookup ***/
+
+// Returns the chunk holding line 'at' and the offset of the line inside it.
+// 'at' must be smaller than size().
+std::pair<std::size_t, std::size_t> rowBuffer::locate(std::size_t at) const
+{
+  std::size_t pos = 0;
+  for (auto step = std::bit_floor(chunks.size()); step != 0; step >>= 1) {
+    if (pos + step <= chunks.size() && tree[pos + step] <= at) {
+      pos += step;
+      at -= tree[pos];
+    }
+  }
+  return { pos, at };
+}
+
+void rowBuffer::materialize(chunk &ch) const
+{
+  ch.rows = std::make_shared<std::vector<erow>>(ch.lazy);
+  for (std::size_t i = 0; i < ch.lazy; i++) {
+    auto &r = (*ch.rows)[i];
+    r.chars = source->line(ch.first + i);
+    r.size = r.chars.length();
+    row::Update(r);
+  }
+  ch.lazy = 0;
+}
+
+// Returns the rows of a chunk for changing them: reads a lazy chunk, and
+// copies rows that a snapshot still shares
+std::vector<erow> &rowBuffer::own(chunk &ch)
+{
+  if (ch.lazy) {
+    materialize(ch);
+  } else if (!ch.rows) {
+    ch.rows = std::make_shared<std::vector<erow>>();
+  } else if (ch.rows.use_count() > 1) {
+    ch.rows = std::make_shared<std::vector<erow>>(*ch.rows);
+  }
+  return *ch.rows;
+}
+
+erow &rowBuffer::operator[](std::size_t at)
+{
+  auto [c, off] = locate(at);
+  return own(chunks[c])[off];
+}
+
+const erow &rowBuffer::operator[](std::size_t at) const
+{
+  auto [c, off] = locate(at);
+  if (chunks[c].lazy) materialize(chunks[c]);
+  return (*chunks[c].rows)[off];
+}
+
+bool rowBuffer::loaded(std::size_t at) const { return chunks[locate(at).first].lazy == 0; }
+
+std::string_view rowBuffer::text(std::size_t at) const
+{
+  auto [c, off] = locate(at);
+  const auto &ch = chunks[c];
+  if (ch.lazy) return source->line(ch.first + off);
+  return (*ch.rows)[off].chars;
+}
+
+/*** Fenwick tree maintenance ***/
+
+void rowBuffer::add(std::size_t c, std::ptrdiff_t delta)
+{
+  for (auto i = c + 1; i <= chunks.size(); i += i & (~i + 1)) {
+    tree[i] = static_cast<std::size_t>(static_cast<std::ptrdiff_t>(tree[i]) + delta);
+  }
+}
+
+void rowBuffer::rebuild()
+{
+  tree.assign(chunks.size() + 1, 0);
+  for (std::size_t i = 1; i <= chunks.size(); i++) {
+    tree[i] += chunks[i - 1].size();
+    auto parent = i + (i & (~i + 1));
+    if (parent <= chunks.size()) tree[parent] += tree[i];
+  }
+}
+
+// Moves the rows of chunk c from 'off' onwards into a new chunk after it.
+// The caller has to rebuild the tree.
+void rowBuffer::split(std::size_t c, std::size_t off)
+{
+  chunk upper;
+  auto &ch = chunks[c];
+  if (ch.lazy) {
+    upper.first = ch.first + off;
+    upper.lazy = ch.lazy - off;
+    ch.lazy = off;
+  } else {
+    auto &rows = own(ch);
+    auto from = rows.begin() + static_cast<std::ptrdiff_t>(off);
+    upper.rows = std::make_shared<std::vector<erow>>(std::make_move_iterator(from), std::make_move_iterator(rows.end()));
+    rows.erase(from, rows.end());
+    // Chunks hold most of the buffer; don't let them keep room they grew into
+    rows.shrink_to_fit();
+  }
+  chunks.insert(chunks.begin() + static_cast<std::ptrdiff_t>(c) + 1, std::move(upper));
+}
+
+/*** editing ***/
+
+erow &rowBuffer::insert(std::size_t at, erow &&r)
+{
+  if (chunks.empty()) {
+    chunks.emplace_back();
+    rebuild();
+  }
+  if (at < tail) tail++;
+
+  std::size_t c, off;
+  if (at >= count) {
+    c = chunks.size() - 1;
+    off = chunks[c].size();
+  } else {
+    std::tie(c, off) = locate(at);
+  }
+
+  auto &rows = own(chunks[c]);
+  rows.insert(rows.begin() + static_cast<std::ptrdiff_t>(off), std::move(r));
+  count++;
+
+  if (rows.size() <= CHUNK_MAX) {
+    add(c, 1);
+    return rows[off];
+  }
+
+  // Rows appended at the end fill chunks completely; elsewhere half of the
+  // chunk is left free for more inserts
+  bool append = (c + 1 == chunks.size() && off + 1 == rows.size());
+  split(c, append ? CHUNK_MAX : rows.size() / 2);
+  rebuild();
+
+  return (*this)[at < count ? at : count - 1];
+}
+
+void rowBuffer::erase(std::size_t at)
+{
+  if (at >= count) return;
+  if (at < tail) tail--;
+
+  auto [c, off] = locate(at);
+  auto &ch = chunks[c];
+  count--;
+
+  // Lines at either end of a lazy chunk can be dropped without reading it
+  if (ch.lazy && (off == 0 || off == ch.lazy - 1)) {
+    if (off == 0) ch.first++;
+    ch.lazy--;
+    if (ch.lazy) {
+      add(c, -1);
+    } else {
+      chunks.erase(chunks.begin() + static_cast<std::ptrdiff_t>(c));
+      rebuild();
+    }
+    return;
+  }
+
+  auto &rows = own(ch);
+  rows.erase(rows.begin() + static_cast<std::ptrdiff_t>(off));
+
+  if (rows.empty()) {
+    chunks.erase(chunks.begin() + static_cast<std::ptrdiff_t>(c));
+    rebuild();
+  } else if (c + 1 < chunks.size() && !chunks[c + 1].lazy && rows.size() + chunks[c + 1].size() <= CHUNK_MAX / 2) {
+    // Merge with the next chunk so that deletes don't leave many tiny chunks
+    auto &next = own(chunks[c + 1]);
+    rows.insert(rows.end(), std::make_move_iterator(next.begin()), std::make_move_iterator(next.end()));
+    chunks.erase(chunks.begin() + static_cast<std::ptrdiff_t>(c) + 1);
+    rebuild();
+  } else {
+    add(c, -1);
+  }
+}
+
+void rowBuffer::clear()
+{
+  chunks.clear();
+  tree.clear();
+  count = 0;
+  source.reset();
+  adopted = 0;
+  tail = 0;
+}
+
+rowSnapshot rowBuffer::snapshot() const
+{
+  rowSnapshot snap;
+  snap.parts.reserve(chunks.size());
+  for (const auto &ch : chunks) {
+    if (ch.size()) snap.parts.push_back(rowSnapshot::part{ ch.rows, ch.first, ch.lazy });
+  }
+  snap.source = source;
+  snap.count = count;
+  return snap;
+}
+
+/*** mapped files ***/
+
+void rowBuffer::attach(std::shared_ptr<const mappedFile> file)
+{
+  source = std::move(file);
+  adopted = 0;
+  tail = count;
+}
+
+std::size_t rowBuffer::adopt()
+{
+  if (!source) return 0;
+  auto lines = source->lines();
+  if (lines <= adopted) return 0;
+
+  auto n = lines - adopted;
+  std::size_t c = chunks.size();
+  if (tail < count) {
+    auto [cc, off] = locate(tail);
+    if (off) split(cc++, off);
+    c = cc;
+  }
+
+  while (adopted < lines) {
+    if (c > 0 && chunks[c - 1].lazy && chunks[c - 1].first + chunks[c - 1].lazy == adopted
+        && chunks[c - 1].lazy < CHUNK_MAX) {
+      auto k = std::min(lines - adopted, CHUNK_MAX - chunks[c - 1].lazy);
+      chunks[c - 1].lazy += k;
+      adopted += k;
+    } else {
+      chunk ch;
+      ch.first = adopted;
+      ch.lazy = std::min(lines - adopted, CHUNK_MAX);
+      adopted += ch.lazy;
+      chunks.insert(chunks.begin() + static_cast<std::ptrdiff_t>(c++), std::move(ch));
+    }
+  }
+
+  count += n;
+  tail += n;
+  rebuild();
+  return n;
+}
+
+bool rowBuffer::indexing() const { return source && (!source->indexed() || adopted < source->lines()); }
+
+void rowBuffer::wait() const
+{
+  if (source) source->wait(std::numeric_limits<std::size_t>::max());
+}
+
+}// end namespace edit
@@ -0,0 +1,208 @@
+#pragma once
+
+#include "arena.h"
+#include "mapped.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace edit {
+
+// A tab in a row: its index in chars and the render column right after it
+struct tabStop
+{
+  std::size_t cx;
+  std::size_t rx;
+};
+
+// A run of rendered columns of one highlight class other than HL_NORMAL
+struct hlSpan
+{
+  std::uint32_t start;
+  std::uint32_t length;
+  unsigned char hl;
+
+  bool operator==(const hlSpan &) const = default;
+};
+
+// The text of a row lives in the row arena; see rowArena
+typedef struct erow
+{
+  std::size_t size{};
+  std::size_t rsize{};
+  rowString chars{};
+  // chars with its tabs expanded; empty for rows without tabs, which are
+  // rendered as they are. Use render() to get whichever applies.
+  rowString expanded{};
+  // The highlighting of the render, as its runs of classes other than
+  // HL_NORMAL in order; columns in none of them are HL_NORMAL
+  hlSpan *hl{ nullptr };
+  std::uint32_t hl_count{};
+  int hl_open_comment{};
+  // The tabs of a long row, found when its columns are first converted and
+  // dropped by row::Update()
+  mutable std::unique_ptr<std::vector<tabStop>> tabs{};
+
+  erow() = default;
+  // Copies the text and highlighting; the tab index is rebuilt when needed
+  erow(const erow &);
+  erow(erow &&) noexcept;
+  erow &operator=(const erow &) = delete;
+  erow &operator=(erow &&) noexcept;
+  ~erow();
+
+  // The row as drawn, rsize bytes long and followed by a '\0'
+  std::string_view render() const { return expanded.empty() ? std::string_view(chars) : std::string_view(expanded); }
+  std::span<const hlSpan> highlight() const { return { hl, hl_count }; }
+  // Replaces the highlighting, reusing its memory if the number of runs is
+  // the same
+  void highlight(std::span<const hlSpan>);
+  // The class of render column 'rx'
+  unsigned char highlightAt(std::size_t rx) const;
+} erow;
+
+// A read-only copy of a rowBuffer, as returned by rowBuffer::snapshot(). It
+// shares its chunks with the buffer, which copies a chunk before changing it
+// for as long as a snapshot holds on to it. A snapshot can be read on another
+// thread while the buffer is edited, but has to be dropped on the thread
+// editing the buffer.
+class rowSnapshot
+{
+public:
+  std::size_t size() const { return count; }
+  // True if some rows are still read from a mapped file
+  bool mapped() const
+  {
+    return std::any_of(parts.begin(), parts.end(), [](const part &p) { return p.lazy != 0; });
+  }
+
+  // Calls f with the characters of every row, in order
+  template<typename F> void forEach(F &&f) const
+  {
+    for (const auto &p : parts) {
+      if (p.lazy) {
+        for (std::size_t i = 0; i < p.lazy; i++) f(source->line(p.first + i));
+      } else {
+        for (const auto &r : *p.rows) f(std::string_view(r.chars));
+      }
+    }
+  }
+
+  // Calls f(row, text, lines) for runs of rows, in order: for a row that has
+  // been read, with its characters and lines == 1, and for rows of a mapped
+  // file that have not, with all of them as one piece of the mapped text,
+  // line terminators included. Only runs overlapping rows [from, to) are
+  // passed, and runs of a mapped file are passed whole.
+  template<typename F> void forEachRun(F &&f, std::size_t from = 0, std::size_t to = SIZE_MAX) const
+  {
+    std::size_t row = 0;
+    for (const auto &p : parts) {
+      if (row >= to) return;
+      auto n = p.lazy ? p.lazy : p.rows->size();
+      if (row + n <= from) {
+        row += n;
+      } else if (p.lazy) {
+        auto head = source->line(p.first);
+        auto tail = source->line(p.first + p.lazy - 1);
+        f(row, std::string_view(head.data(), static_cast<std::size_t>(tail.data() + tail.size() - head.data())), p.lazy);
+        row += p.lazy;
+      } else {
+        for (std::size_t i = from > row ? from - row : 0; i < n && row + i < to; i++) {
+          f(row + i, std::string_view((*p.rows)[i].chars), std::size_t{ 1 });
+        }
+        row += n;
+      }
+    }
+  }
+
+private:
+  friend class rowBuffer;
+
+  struct part
+  {
+    std::shared_ptr<const std::vector<erow>> rows;
+    std::size_t first;
+    std::size_t lazy;
+  };
+
+  std::vector<part> parts{};
+  std::shared_ptr<const mappedFile> source{};
+  std::size_t count{};
+};
+
+// Rows are stored in a sequence of small chunks instead of one contiguous
+// vector. A Fenwick tree over the chunk sizes maps a line number to its chunk,
+// so lookup, insert and delete are O(log n) plus a move of at most one chunk,
+// and no per-row line number has to be renumbered after an edit.
+//
+// A chunk can also stand for a range of lines of a mapped file that have not
+// been read yet. Such a chunk is turned into real rows the first time one of
+// its rows is accessed.
+class rowBuffer
+{
+public:
+  std::size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+
+  erow &operator[](std::size_t at);
+  const erow &operator[](std::size_t at) const;
+  // True if row 'at' has been read from the mapped file (or was never lazy)
+  bool loaded(std::size_t at) const;
+  // The characters of row 'at', straight from the mapped file if the row
+  // hasn't been read, without reading it
+  std::string_view text(std::size_t at) const;
+
+  erow &insert(std::size_t at, erow &&r);
+  void erase(std::size_t at);
+  void clear();
+
+  // Takes a snapshot of the rows in O(chunks); lines of a mapped file that are
+  // not adopted yet are left out
+  rowSnapshot snapshot() const;
+
+  // Backs the buffer with a mapped file. Its lines are added with adopt()
+  // as the background indexer finds them.
+  void attach(std::shared_ptr<const mappedFile> file);
+  // Adds lines of the mapped file indexed since the last call, as lazy rows,
+  // after the last adopted line. Returns the number of rows added.
+  std::size_t adopt();
+  // True while the mapped file has lines that are not adopted yet
+  bool indexing() const;
+  // Blocks until the whole mapped file has been indexed
+  void wait() const;
+
+private:
+  struct chunk
+  {
+    // Shared with snapshots; see own()
+    std::shared_ptr<std::vector<erow>> rows{};
+    std::size_t first{};// first source line of a lazy chunk
+    std::size_t lazy{};// number of source lines not read yet
+
+    std::size_t size() const { return lazy ? lazy : rows ? rows->size() : 0; }
+  };
+
+  std::pair<std::size_t, std::size_t> locate(std::size_t at) const;
+  void materialize(chunk &) const;
+  std::vector<erow> &own(chunk &);
+  void split(std::size_t c, std::size_t off);
+  void add(std::size_t c, std::ptrdiff_t delta);
+  void rebuild();
+
+  mutable std::vector<chunk> chunks{};
+  std::vector<std::size_t> tree{};// Fenwick tree, 1-based, over chunk sizes
+  std::size_t count{};
+
+  std::shared_ptr<const mappedFile> source{};
+  std::size_t adopted{};// source lines adopted so far
+  std::size_t tail{};// row position where the next adopted line goes
+};
+
+}// end namespace edit
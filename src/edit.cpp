@@ -1,92 +1,208 @@
 #include "edit.h"
+#include "lineindex.h"
 #include "row.h"
+#include "search.h"
 #include "syntax.h"
 
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
 #include <fstream>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <system_error>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
 
 #include <cctype>
+#include <cstdint>
 #include <cerrno>
 #include <cstdarg>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
+#include <climits>
 #include <fcntl.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
 
 namespace edit {
 
+// Files at least this large are mapped and read lazily instead of loaded
+const std::uintmax_t KILO_MMAP_THRESHOLD{ 32 << 20 };
+// Lines handed to each writev() when saving, two iovecs each
+const std::size_t KILO_SAVE_BATCH{ 512 };
+
 /*** data ***/
 struct editorConfig E;
 
 editorConfig &referenceToE() { return E; }
 
 /*** editor operations ***/
-edit::erow &Insert(edit::editorConfig &E, const int at, const std::string &s)
+edit::erow &Insert(edit::editorConfig &E, const int at, std::string_view s)
 {
   auto idx = static_cast<std::size_t>(at);
 
   edit::erow newRow{};
-  E.row.insert(E.row.begin() + idx, newRow);
-
-  for (auto j = idx + 1; j <= E.numrows; j++) E.row[j].idx++;
-
-  E.row[at].idx = idx;
-
-  E.row[at].size = s.length();
-  E.row[at].chars = s;
+  newRow.size = s.length();
+  newRow.chars = s;
+  // Until it is highlighted, the new row passes on the comment state that the
+  // row after it was highlighted with
+  if (idx > 0 && idx < E.hl_valid) newRow.hl_open_comment = std::as_const(E.row)[idx - 1].hl_open_comment;
+  row::Update(newRow);
 
-  E.row[at].rsize = 0;
-  E.row[at].render = "";
-  E.row[at].hl = nullptr;
-  E.row[at].hl_open_comment = 0;
-  row::Update(E.row[idx]);
+  E.row.insert(idx, std::move(newRow));
 
   E.numrows++;
   E.dirty++;
 
+  // Rows past the highlighting watermark are highlighted when drawn
+  if (idx < E.hl_valid) {
+    E.hl_valid++;
+    syntax::Update(E, idx);
+  }
+
   return E.row[idx];
 }
 
-void editorFreeRow(edit::erow &r) { free(r.hl); }
-
 void Del(edit::editorConfig &E, const int at)
 {
   if (at < 0 || static_cast<std::size_t>(at) >= E.numrows) return;
 
   auto idx = static_cast<std::size_t>(at);
-  editorFreeRow(E.row[idx]);
-  E.row.erase(E.row.begin() + idx);
-  for (auto j = idx; j < E.numrows - 1; j++) E.row[j].idx--;
+  E.row.erase(idx);
   E.numrows--;
   E.dirty++;
+
+  // The row that moved up may now start in a different comment state
+  if (idx < E.hl_valid) {
+    E.hl_valid--;
+    if (idx < E.hl_valid) syntax::Update(E, idx);
+  }
 }
 
+namespace {
+
+  // Inserts text, whose rows are separated by '\n', at row 'at', column
+  // 'col'. Returns the row and column where it ends.
+  std::pair<std::size_t, std::size_t> insertAt(editorConfig &E, std::size_t at, std::size_t col, std::string_view text)
+  {
+    auto nl = text.find('\n');
+    rowString tail;
+    {
+      edit::erow &r = E.row[at];
+      tail = r.chars.substr(col);
+      r.chars.erase(col);
+      r.chars.append(text.substr(0, nl));
+    }
+    auto line = at;
+    while (nl != std::string_view::npos) {
+      auto start = nl + 1;
+      nl = text.find('\n', start);
+      edit::Insert(E, static_cast<int>(++line), text.substr(start, nl == std::string_view::npos ? nl : nl - start));
+    }
+
+    edit::erow &last = E.row[line];
+    auto end = last.chars.size();
+    last.chars += tail;
+    last.size = last.chars.size();
+    row::Update(last, line == at ? col : 0);
+    if (line != at) {
+      edit::erow &r = E.row[at];
+      r.size = r.chars.size();
+      row::Update(r, col);
+    }
+    syntax::Update(E, at);
+    return { line, end };
+  }
+
+  // Deletes text, as inserted by insertAt(), from row 'at', column 'col'
+  void eraseAt(editorConfig &E, std::size_t at, std::size_t col, std::string_view text)
+  {
+    auto joined = static_cast<std::size_t>(std::count(text.begin(), text.end(), '\n'));
+    auto nl = text.rfind('\n');
+    auto to = joined ? text.size() - nl - 1 : col + text.size();// column it ends at
+    if (joined) {
+      // The last row is deleted below, so it isn't taken for writing
+      auto rest = std::string(E.row.text(at + joined).substr(to));
+      edit::erow &r = E.row[at];
+      r.chars.erase(col);
+      r.chars += rest;
+      for (std::size_t i = 0; i < joined; i++) edit::Del(E, static_cast<int>(at + 1));
+    } else {
+      E.row[at].chars.erase(col, to - col);
+    }
+    edit::erow &r = E.row[at];
+    r.size = r.chars.size();
+    row::Update(r, col);
+    syntax::Update(E, at);
+  }
+
+}// namespace
+
 void InsertChar(const char c)
 {
-  if (E.cy == E.numrows) { syntax::Update(E, edit::Insert(E, static_cast<int>(E.numrows), "")); }
+  if (E.cy == E.numrows) {
+    E.history.begin();
+    E.history.add(undo::op::insertRow, E.numrows, 0, "");
+    edit::Insert(E, static_cast<int>(E.numrows), "");
+  }
+  E.history.type(E.cy, E.cx, c);
   row::InsertChar(E.row[E.cy], static_cast<int>(E.cx), c);
-  syntax::Update(E, E.row[E.cy]);
+  syntax::Update(E, E.cy);
   E.dirty++;
   E.cx++;
 }
 
+void InsertText(editorConfig &E, std::string_view text)
+{
+  if (text.empty()) return;
+  E.history.begin();
+  if (E.cy == E.numrows) {
+    E.history.add(undo::op::insertRow, E.numrows, 0, "");
+    edit::Insert(E, static_cast<int>(E.numrows), "");
+  }
+
+  // Rows are split at "\n", "\r" and "\r\n"
+  std::string lines;
+  lines.reserve(text.size());
+  for (std::size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\r') {
+      lines += '\n';
+      if (i + 1 < text.size() && text[i + 1] == '\n') i++;
+    } else {
+      lines += text[i];
+    }
+  }
+  E.history.add(undo::op::insertText, E.cy, E.cx, lines);
+  std::tie(E.cy, E.cx) = insertAt(E, E.cy, E.cx, lines);
+  E.dirty++;
+}
+
 void InsertNewLine()
 {
+  E.history.begin();
+  if (E.cy == E.numrows) {
+    E.history.add(undo::op::insertRow, E.cy, 0, "");
+  } else {
+    E.history.add(undo::op::insertText, E.cy, E.cx, "\n");
+  }
   if (E.cx == 0) {
-    syntax::Update(E, edit::Insert(E, static_cast<int>(E.cy), ""));
+    edit::Insert(E, static_cast<int>(E.cy), "");
   } else {
     if (E.cy <= E.numrows) {
-      syntax::Update(
-        E, edit::Insert(E, static_cast<int>(E.cy) + 1, E.row[E.cy].chars.substr(E.cx, E.row[E.cy].size - E.cx)));
+      edit::Insert(E, static_cast<int>(E.cy) + 1, E.row[E.cy].chars.substr(E.cx, E.row[E.cy].size - E.cx));
     }
     E.row[E.cy].chars.erase(E.cx, E.row[E.cy].size - E.cx);
     E.row[E.cy].size = E.cx;
-    row::Update(E.row[E.cy]);
-    syntax::Update(E, E.row[E.cy]);
+    row::Update(E.row[E.cy], E.cx);
+    syntax::Update(E, E.cy);
   }
   E.dirty++;
   E.cy++;
@@ -99,47 +215,295 @@ void DelChar()
   if (E.cx == 0 && E.cy == 0) return;
 
   edit::erow &row = E.row[E.cy];
+  E.history.begin();
   if (E.cx > 0) {
+    E.history.add(undo::op::deleteText, E.cy, E.cx - 1, std::string_view(&row.chars[E.cx - 1], 1));
     row::DelChar(row, static_cast<int>(E.cx) - 1);
-    syntax::Update(E, E.row[E.cy - 1]);
+    syntax::Update(E, E.cy);
     E.dirty++;
     E.cx--;
   } else {
     E.cx = E.row[E.cy - 1].size;
+    E.history.add(undo::op::deleteText, E.cy - 1, E.cx, "\n");
     row::AppendString(E.row[E.cy - 1], row.chars);
-    syntax::Update(E, E.row[E.cy - 1]);
     E.dirty++;
     edit::Del(E, static_cast<int>(E.cy));
     E.cy--;
+    syntax::Update(E, E.cy);
+  }
+}
+
+std::size_t ReplaceAll(editorConfig &E, const std::vector<search::match> &matches, std::string_view with)
+{
+  std::size_t replaced = 0;
+  rowString text;
+  E.history.begin();
+  for (std::size_t i = 0; i < matches.size();) {
+    auto at = matches[i].row;
+    edit::erow &r = E.row[at];
+    auto first = matches[i].col;
+    std::size_t done = 0;// chars of the row copied or replaced so far
+    text.clear();
+    for (; i < matches.size() && matches[i].row == at; i++) {
+      const auto &m = matches[i];
+      if (m.col < done || m.col + m.length > r.size) continue;
+      text.append(r.chars, done, m.col - done);
+      text.append(with);
+      done = m.col + m.length;
+      replaced++;
+    }
+    text.append(r.chars, done);
+    if (first < r.size) {
+      E.history.add(undo::op::deleteText, at, first, std::string_view(r.chars).substr(first));
+      E.history.add(undo::op::insertText, at, first, std::string_view(text).substr(first));
+    }
+    std::swap(r.chars, text);
+    r.size = r.chars.size();
+    row::Update(r, first);
+    syntax::Update(E, at);
   }
+  if (replaced) E.dirty++;
+  if (E.cy < E.numrows) E.cx = std::min(E.cx, std::as_const(E.row)[E.cy].size);
+  return replaced;
+}
+
+bool Undo(editorConfig &E)
+{
+  auto group = E.history.undo();
+  if (group.empty()) return false;
+  for (auto it = group.rbegin(); it != group.rend(); ++it) {
+    auto text = E.history.text(*it);
+    E.cy = it->row;
+    E.cx = it->col;
+    switch (it->kind) {
+    case undo::op::insertRow:
+      edit::Del(E, static_cast<int>(it->row));
+      break;
+    case undo::op::insertText:
+      eraseAt(E, it->row, it->col, text);
+      break;
+    case undo::op::deleteText:
+      std::tie(E.cy, E.cx) = insertAt(E, it->row, it->col, text);
+      break;
+    }
+  }
+  E.dirty++;
+  return true;
+}
+
+bool Redo(editorConfig &E)
+{
+  auto group = E.history.redo();
+  if (group.empty()) return false;
+  for (const auto &r : group) {
+    auto text = E.history.text(r);
+    E.cy = r.row;
+    E.cx = r.col;
+    switch (r.kind) {
+    case undo::op::insertRow:
+      edit::Insert(E, static_cast<int>(r.row), text);
+      break;
+    case undo::op::insertText:
+      std::tie(E.cy, E.cx) = insertAt(E, r.row, r.col, text);
+      break;
+    case undo::op::deleteText:
+      eraseAt(E, r.row, r.col, text);
+      break;
+    }
+  }
+  E.dirty++;
+  return true;
 }
 
 // /*** file i/o ***/
 
-char *RowsToString(int *buflen)
+namespace {
+
+  // Writes all of iov, however many calls it takes
+  void writeAll(int fd, std::vector<iovec> &iov)
+  {
+    std::size_t done = 0;
+    while (done < iov.size()) {
+      auto n = writev(fd, &iov[done], static_cast<int>(std::min<std::size_t>(iov.size() - done, IOV_MAX)));
+      if (n == -1) {
+        if (errno == EINTR) continue;
+        throw std::system_error(errno, std::generic_category(), "writev");
+      }
+      auto left = static_cast<std::size_t>(n);
+      while (done < iov.size() && left >= iov[done].iov_len) left -= iov[done++].iov_len;
+      if (left) {
+        iov[done].iov_base = static_cast<char *>(iov[done].iov_base) + left;
+        iov[done].iov_len -= left;
+      }
+    }
+  }
+
+}// namespace
+
+namespace {
+
+  // Writes the rows to fd and syncs it, returning the number of bytes written
+  std::size_t writeRows(int fd, const rowSnapshot &rows, std::atomic<std::size_t> *written)
+  {
+    static const char newline = '\n';
+    std::size_t total = 0;
+    std::vector<iovec> iov;
+    iov.reserve(2 * KILO_SAVE_BATCH);
+    std::size_t batch = 0;
+    auto flush = [&] {
+      writeAll(fd, iov);
+      iov.clear();
+      if (written) written->fetch_add(batch, std::memory_order_relaxed);
+      batch = 0;
+    };
+    rows.forEach([&](std::string_view line) {
+      if (!line.empty()) iov.push_back(iovec{ const_cast<char *>(line.data()), line.size() });
+      iov.push_back(iovec{ const_cast<char *>(&newline), 1 });
+      total += line.size() + 1;
+      if (++batch == KILO_SAVE_BATCH) flush();
+    });
+    flush();
+    if (fsync(fd) == -1) throw std::system_error(errno, std::generic_category(), "fsync");
+    return total;
+  }
+
+  // Overwrites the file itself, for when no file can be made next to it
+  std::size_t writeInPlace(const rowSnapshot &rows, const std::string &path, std::atomic<std::size_t> *written)
+  {
+    int fd = open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd == -1) throw std::system_error(errno, std::generic_category(), "open");
+    std::size_t total = 0;
+    try {
+      total = writeRows(fd, rows, written);
+      if (ftruncate(fd, static_cast<off_t>(total)) == -1) {
+        throw std::system_error(errno, std::generic_category(), "ftruncate");
+      }
+    } catch (...) {
+      close(fd);
+      throw;
+    }
+    if (close(fd) == -1) throw std::system_error(errno, std::generic_category(), "close");
+    return total;
+  }
+
+}// namespace
+
+std::size_t WriteFile(const rowSnapshot &rows, const std::string &filename, std::atomic<std::size_t> *written)
 {
-  auto totlen = 0;
-  for (auto j = 0; j < static_cast<int>(E.numrows); j++) totlen += E.row[j].size + 1;
-  *buflen = totlen;
+  // Through a symlink, the file it points to is the one replaced
+  std::string path = filename;
+  if (char *real = realpath(filename.c_str(), nullptr)) {
+    path = real;
+    free(real);
+  }
+
+  std::string tmp = path + ".XXXXXX";
+  int fd = mkstemp(tmp.data());
+  if (fd == -1) {
+    // Rows still read from the file would change under us as it is written
+    if (rows.mapped()) throw std::system_error(errno, std::generic_category(), "mkstemp");
+    return writeInPlace(rows, path, written);
+  }
+
+  std::size_t total = 0;
+  try {
+    // The new file gets the owner and permissions of the one it replaces, as
+    // far as we are allowed to give them
+    struct stat st;
+    mode_t mode;
+    if (stat(path.c_str(), &st) == 0) {
+      if (fchown(fd, st.st_uid, st.st_gid) == -1 && errno != EPERM) {
+        throw std::system_error(errno, std::generic_category(), "fchown");
+      }
+      mode = st.st_mode & 07777;
+    } else {
+      mode = umask(0);
+      umask(mode);
+      mode = 0666 & ~mode;
+    }
+    if (fchmod(fd, mode) == -1) throw std::system_error(errno, std::generic_category(), "fchmod");
+
+    total = writeRows(fd, rows, written);
+    int closed = close(fd);
+    fd = -1;
+    if (closed == -1) throw std::system_error(errno, std::generic_category(), "close");
+    if (rename(tmp.c_str(), path.c_str()) == -1) throw std::system_error(errno, std::generic_category(), "rename");
+  } catch (...) {
+    if (fd != -1) close(fd);
+    unlink(tmp.c_str());
+    throw;
+  }
+
+  // Make the rename itself durable; the data is safe either way
+  auto dir = std::filesystem::path(path).parent_path();
+  int dfd = open(dir.empty() ? "." : dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (dfd != -1) {
+    fsync(dfd);
+    close(dfd);
+  }
+
+  return total;
+}
+
+namespace {
 
-  if (totlen > 0) {
-    char *buf = static_cast<char *>(malloc(static_cast<std::size_t>(totlen)));
-    char *p = buf;
-    for (auto j = 0; j < static_cast<int>(E.numrows); j++) {
-      memcpy(p, E.row[j].chars.c_str(), E.row[j].size);
-      p += E.row[j].size;
-      *p = '\n';
-      p++;
+  // Lines still being indexed belong in the file too
+  void waitForIndex(editorConfig &E)
+  {
+    if (E.row.indexing()) {
+      E.row.wait();
+      Poll(E);
     }
-    return buf;
-  } else
-    return nullptr;
+  }
+
+}// namespace
+
+std::size_t Save(editorConfig &E)
+{
+  waitForIndex(E);
+  auto total = WriteFile(E.row.snapshot(), E.filename);
+  E.dirty = 0;
+  return total;
+}
+
+saveJob::saveJob(editorConfig &E) : filename(E.filename)
+{
+  if (!E.row.indexing()) start(E);
+}
+
+void saveJob::start(editorConfig &E)
+{
+  rows = E.row.snapshot();
+  dirty = E.dirty;
+  result = std::async(std::launch::async, [this] { return WriteFile(rows, filename, &written); });
+}
+
+bool saveJob::done(editorConfig &E)
+{
+  if (!result.valid()) {
+    Poll(E);
+    if (E.row.indexing()) return false;
+    start(E);
+  }
+  return result.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+}
+
+std::size_t saveJob::finish(editorConfig &E)
+{
+  if (!result.valid()) {
+    waitForIndex(E);
+    start(E);
+  }
+  auto total = result.get();
+  // Edits made while the file was written are not in it
+  E.dirty = std::max(E.dirty - dirty, 0);
+  return total;
 }
 
 void Scroll()
 {
   E.rx = 0;
-  if (E.cy < E.numrows) { E.rx = row::CxToRx(E.row[E.cy], E.cx); }
+  if (E.cy < E.numrows) { E.rx = row::CxToRx(std::as_const(E.row)[E.cy], E.cx); }
   if (E.cy < E.rowoff) { E.rowoff = E.cy; }
   if (E.cy >= E.rowoff + static_cast<std::size_t>(E.screenrows)) {
     E.rowoff = E.cy - static_cast<std::size_t>(E.screenrows) + 1;
@@ -150,6 +514,8 @@ void Scroll()
   }
 }
 
+void Poll(editorConfig &E) { E.numrows += E.row.adopt(); }
+
 void Open(char *filename)
 {
 #ifdef _WIN32
@@ -159,16 +525,30 @@ void Open(char *filename)
 #endif
   syntax::SelectHighlight(E);
 
-  std::ifstream f(filename);
+  std::error_code ec;
+  auto fsize = std::filesystem::file_size(filename, ec);
+  if (ec) throw std::runtime_error("File failed to open.");
+
+  if (fsize >= KILO_MMAP_THRESHOLD) {
+    auto file = std::make_shared<const mappedFile>(filename);
+    file->wait(static_cast<std::size_t>(E.screenrows) + 1);
+    E.row.attach(std::move(file));
+    Poll(E);
+    E.dirty = 0;
+    return;
+  }
+
+  std::ifstream f(filename, std::ios::binary);
   if (f.fail()) throw std::runtime_error("File failed to open.");
-  std::string line;
-  std::getline(f, line);
-  while (f.rdstate() == std::ios_base::goodbit) {
-    std::size_t linelen = line.size();
-    while (linelen > 0 && (line[linelen - 1] == '\n' || line[linelen - 1] == '\r')) linelen--;
-    syntax::Update(E, edit::Insert(E, static_cast<int>(E.numrows), line));
-    std::getline(f, line);
+  std::string text(static_cast<std::size_t>(fsize), '\0');
+  f.read(text.data(), static_cast<std::streamsize>(text.size()));
+  text.resize(static_cast<std::size_t>(f.gcount()));
+
+  auto index = IndexLines(text.data(), text.size());
+  for (std::size_t n = 0; n < index.lines(); n++) {
+    edit::Insert(E, static_cast<int>(E.numrows), text.substr(index.start(n), index.length(n)));
   }
+  syntax::HighlightAll(E);
   E.dirty = 0;
 }
 
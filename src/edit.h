@@ -1,8 +1,21 @@
 #pragma once
 
+#include "buffer.h"
+#include "undo.h"
+
+#include <atomic>
+#include <future>
 #include <string>
+#include <string_view>
 #include <vector>
 
+namespace search {
+struct match;
+}
+namespace syntax {
+class lexer;
+}
+
 namespace edit {
 
 const std::string KILO_VERSION{ "0.0.1" };
@@ -17,20 +30,10 @@ struct editorSyntax
   const char *multiline_comment_start;
   const char *multiline_comment_end;
   int flags;
+  // The rules compiled by syntax::Compile(); nothing is highlighted until then
+  const syntax::lexer *lexer;
 };
 
-typedef struct erow
-{
-  std::size_t idx;
-  std::size_t size;
-  std::size_t rsize;
-  std::string chars{};
-  std::string render{};
-  unsigned char *hl;
-  int hl_open_comment;
-} erow;
-
-
 struct editorConfig
 {
   std::size_t cx, cy;
@@ -40,8 +43,11 @@ struct editorConfig
   int screenrows;
   int screencols;
   std::size_t numrows;
-  std::vector<erow> row{};
+  rowBuffer row{};
+  std::size_t hl_valid{};// rows before this one are highlighted with the right comment state
   int dirty;
+  // Edits made with the operations below, for Undo() and Redo()
+  undo::history history{};
   std::string filename{};
   char statusmsg[80];
   time_t statusmsg_time;
@@ -50,15 +56,69 @@ struct editorConfig
 
 editorConfig &referenceToE();
 
-edit::erow &Insert(edit::editorConfig &, const int, const std::string &);
+edit::erow &Insert(edit::editorConfig &, const int, std::string_view);
 void Del(edit::editorConfig &, const int);
 void InsertChar(const char c);
+// Inserts text at the cursor as one edit, splitting it into rows at "\n",
+// "\r" and "\r\n"; the cursor ends up after the text
+void InsertText(editorConfig &, std::string_view text);
 void InsertNewLine();
 void DelChar();
-char *RowsToString(int *buflen);
+// Replaces the given matches, sorted by row and column, with 'with' as one
+// edit: every row with matches is rebuilt, re-rendered and re-highlighted
+// once, however many it has. A match overlapping the one before it in its
+// row is skipped. Returns the number of matches replaced.
+std::size_t ReplaceAll(editorConfig &, const std::vector<search::match> &matches, std::string_view with);
+// Undoes the last group of edits made with the operations above, or redoes
+// the last one undone, re-highlighting only the rows it touches, and puts
+// the cursor where it happened. Return false if there is none.
+bool Undo(editorConfig &);
+bool Redo(editorConfig &);
+// Writes the rows to a temporary file next to filename, syncs it and renames
+// it over the original, so that a failed save leaves the old file intact.
+// A symlink is followed and the file it points to replaced. Where no file
+// can be made next to it, the file is overwritten in place instead, unless
+// rows are still read from a mapped file. Rows are written from where they
+// are stored, without building the file in memory. Adds the rows written so far to *written as it goes. Returns the
+// number of bytes written; throws std::system_error on failure.
+std::size_t WriteFile(const rowSnapshot &, const std::string &filename, std::atomic<std::size_t> *written = nullptr);
+// Writes the buffer to E.filename with WriteFile() and marks it clean
+std::size_t Save(editorConfig &);
+
+// A save running on a thread of its own, against a snapshot of the buffer
+// taken when it starts, so that editing can go on meanwhile. While a mapped
+// file is still being indexed the snapshot would miss lines, so the job only
+// starts once indexing is done, as done() finds.
+class saveJob
+{
+public:
+  explicit saveJob(editorConfig &);
+
+  saveJob(const saveJob &) = delete;
+  saveJob &operator=(const saveJob &) = delete;
+
+  std::size_t lines() const { return rows.size(); }
+  std::size_t linesWritten() const { return written.load(std::memory_order_relaxed); }
+  // Starts the save if it was waiting and can now; true once it has ended
+  bool done(editorConfig &);
+  // Waits for the save to end and returns the number of bytes written, or
+  // throws what Save() would. Edits made since the snapshot leave E dirty.
+  std::size_t finish(editorConfig &);
+
+private:
+  void start(editorConfig &);
+
+  rowSnapshot rows{};
+  std::string filename{};
+  int dirty{};// E.dirty when the snapshot was taken
+  std::atomic<std::size_t> written{};
+  // Last, so that destroying the job waits for the thread before the rows go
+  std::future<std::size_t> result{};
+};
 
 void Scroll();
 
 void Open(char *filename);
+void Poll(editorConfig &);
 
 }// end namespace edit
@@ -0,0 +1,125 @@
+#include "events.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <stdexcept>
+#include <utility>
+
+#include <poll.h>
+#include <signal.h>
+#include <sys/signalfd.h>
+#include <unistd.h>
+
+namespace events {
+
+eventLoop::~eventLoop()
+{
+  for (auto &w : watchers) {
+    if (w.signo == 0) continue;
+    close(w.fd);
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, w.signo);
+    pthread_sigmask(SIG_UNBLOCK, &mask, nullptr);
+  }
+}
+
+void eventLoop::watch(int fd, std::function<void()> ready) { watchers.push_back(watcher{ fd, 0, std::move(ready) }); }
+
+void eventLoop::writable(int fd, std::function<bool()> ready) { sinks.push_back(sink{ fd, std::move(ready) }); }
+
+void eventLoop::signal(int signo, std::function<void()> caught)
+{
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, signo);
+  if (pthread_sigmask(SIG_BLOCK, &mask, nullptr) != 0) throw std::runtime_error("pthread_sigmask() failed");
+  int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+  if (fd == -1) throw std::runtime_error("signalfd() failed");
+  watchers.push_back(watcher{ fd, signo, std::move(caught) });
+}
+
+void eventLoop::every(clock::duration period, std::function<bool()> tick)
+{
+  timers.push_back(timer{ clock::now() + period, period, std::move(tick) });
+}
+
+void eventLoop::idle(std::function<bool()> slice) { tasks.push_back(task{ std::move(slice), true }); }
+
+int eventLoop::runTimers()
+{
+  auto now = clock::now();
+  for (std::size_t i = 0; i < timers.size();) {
+    auto &t = timers[i];
+    if (t.next > now) {
+      i++;
+      continue;
+    }
+    // A timer that fell behind isn't run again to catch up
+    t.next = std::max(t.next + t.period, now);
+    // Held outside the vector while it runs, as it may add timers of its own
+    auto tick = std::move(t.tick);
+    if (tick()) {
+      timers[i++].tick = std::move(tick);
+    } else {
+      timers.erase(timers.begin() + static_cast<std::ptrdiff_t>(i));
+    }
+  }
+
+  if (timers.empty()) return -1;
+  auto next = std::min_element(timers.begin(), timers.end(), [](const timer &a, const timer &b) {
+    return a.next < b.next;
+  })->next;
+  auto wait = std::chrono::ceil<std::chrono::milliseconds>(next - clock::now()).count();
+  return static_cast<int>(std::max<decltype(wait)>(wait, 0));
+}
+
+void eventLoop::run()
+{
+  stopped = false;
+  std::vector<pollfd> fds;
+  while (!stopped) {
+    int timeout = runTimers();
+    if (stopped) break;
+    bool busy = std::any_of(tasks.begin(), tasks.end(), [](const task &t) { return t.active; });
+    if (busy) timeout = 0;
+
+    fds.clear();
+    for (auto &w : watchers) fds.push_back(pollfd{ w.fd, POLLIN, 0 });
+    for (auto &s : sinks) fds.push_back(pollfd{ s.fd, POLLOUT, 0 });
+    auto polled = watchers.size();
+    int n = poll(fds.data(), fds.size(), timeout);
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("poll() failed");
+    }
+
+    if (n == 0) {
+      for (auto &t : tasks) {
+        if (t.active) t.active = t.slice();
+      }
+      continue;
+    }
+
+    for (std::size_t i = 0; i < polled && !stopped; i++) {
+      if (fds[i].revents == 0) continue;
+      auto &w = watchers[i];
+      if (w.signo != 0) {
+        signalfd_siginfo info;
+        while (read(w.fd, &info, sizeof(info)) == sizeof(info)) {}
+      }
+      w.ready();
+    }
+    // The handlers above may have added sinks, which come after those polled
+    for (std::size_t i = polled, s = 0; i < fds.size() && !stopped; i++) {
+      if (fds[i].revents == 0 || sinks[s].ready()) {
+        s++;
+      } else {
+        sinks.erase(sinks.begin() + static_cast<std::ptrdiff_t>(s));
+      }
+    }
+    for (auto &t : tasks) t.active = true;
+  }
+}
+
+}// end namespace events
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+namespace events {
+
+// Waits in poll(2) for input, signals and timers and runs their handlers, so
+// that the editor sleeps while nothing happens. Idle tasks run in short
+// slices whenever there is nothing else to do.
+class eventLoop
+{
+public:
+  using clock = std::chrono::steady_clock;
+
+  eventLoop() = default;
+  ~eventLoop();
+
+  eventLoop(const eventLoop &) = delete;
+  eventLoop &operator=(const eventLoop &) = delete;
+
+  // Calls ready() whenever fd can be read
+  void watch(int fd, std::function<void()> ready);
+  // Calls ready() whenever fd can be written to, for as long as it returns
+  // true, so that output that didn't fit is finished without blocking
+  void writable(int fd, std::function<bool()> ready);
+  // Delivers the signal through a signalfd instead of interrupting the
+  // program. The signal is blocked in the calling thread: threads started
+  // after this call inherit that, threads started before could still take it.
+  void signal(int signo, std::function<void()> caught);
+  // Calls tick() every period for as long as it returns true; a tick that
+  // returns false at once makes a one-shot timer. Ticks may add timers.
+  void every(clock::duration period, std::function<bool()> tick);
+  // Calls slice() while the loop has nothing else to do, for as long as it
+  // returns true. Tasks that finished are woken again by the next event.
+  void idle(std::function<bool()> slice);
+
+  // Dispatches events until stop() is called
+  void run();
+  void stop() { stopped = true; }
+
+private:
+  struct watcher
+  {
+    int fd;
+    int signo;// 0 unless fd is a signalfd
+    std::function<void()> ready;
+  };
+  struct sink
+  {
+    int fd;
+    std::function<bool()> ready;
+  };
+  struct timer
+  {
+    clock::time_point next;
+    clock::duration period;
+    std::function<bool()> tick;
+  };
+  struct task
+  {
+    std::function<bool()> slice;
+    bool active;
+  };
+
+  // Runs the timers that are due and returns the poll() timeout until the next
+  int runTimers();
+
+  std::vector<watcher> watchers{};
+  std::vector<sink> sinks{};
+  std::vector<timer> timers{};
+  std::vector<task> tasks{};
+  bool stopped{ false };
+};
+
+}// end namespace events
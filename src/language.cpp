@@ -0,0 +1,343 @@
+#include "language.h"
+#include "syntax.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+#include <system_error>
+#include <utility>
+
+namespace syntax {
+
+// /*** filetypes ***/
+
+const char *C_HL_extensions[] = { ".c", ".h", ".cpp", nullptr };
+const char *C_HL_keywords[] = { "switch",
+  "if",
+  "while",
+  "for",
+  "break",
+  "continue",
+  "return",
+  "else",
+  "struct",
+  "union",
+  "typedef",
+  "static",
+  "enum",
+  "class",
+  "case",
+  "int|",
+  "long|",
+  "double|",
+  "float|",
+  "char|",
+  "unsigned|",
+  "signed|",
+  "void|",
+  nullptr };
+
+struct edit::editorSyntax HLDB[] = {
+  { "c", C_HL_extensions, C_HL_keywords, "//", "/*", "*/", HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS, nullptr },
+};
+
+// /*** definition files ***/
+
+namespace {
+
+  const char MAGIC[8] = { 'K', 'I', 'L', 'O', 'S', 'Y', 'N', '\0' };
+  const std::size_t HEADER{ sizeof(MAGIC) + 4 + 4 + 8 };
+
+  struct definition
+  {
+    std::string name{};
+    std::vector<std::string> match{};
+    std::vector<std::string> keywords{};
+    std::string scs{};
+    std::string mcs{};
+    std::string mce{};
+    std::uint32_t flags{};
+  };
+
+  definition parse(const std::string &text)
+  {
+    definition d;
+    std::istringstream in(text);
+    std::string line;
+    for (int number = 1; std::getline(in, line); number++) {
+      std::istringstream words(line);
+      std::string key;
+      if (!(words >> key) || key[0] == '#') continue;
+      std::vector<std::string> values{ std::istream_iterator<std::string>(words), std::istream_iterator<std::string>() };
+      auto fail = [&](const std::string &what) {
+        throw std::runtime_error("line " + std::to_string(number) + ": " + what);
+      };
+      auto one = [&](std::string &to, std::size_t count = 1) {
+        if (values.size() != count) fail("'" + key + "' takes " + std::to_string(count) + " value(s)");
+        to = values[0];
+      };
+      if (key == "name") {
+        one(d.name);
+      } else if (key == "match") {
+        d.match.insert(d.match.end(), values.begin(), values.end());
+      } else if (key == "keywords") {
+        d.keywords.insert(d.keywords.end(), values.begin(), values.end());
+      } else if (key == "comment") {
+        one(d.scs);
+      } else if (key == "multiline") {
+        one(d.mcs, 2);
+        d.mce = values[1];
+      } else if (key == "highlight") {
+        for (const auto &v : values) {
+          if (v == "numbers") {
+            d.flags |= HL_HIGHLIGHT_NUMBERS;
+          } else if (v == "strings") {
+            d.flags |= HL_HIGHLIGHT_STRINGS;
+          } else {
+            fail("can't highlight '" + v + "'");
+          }
+        }
+      } else {
+        fail("unknown setting '" + key + "'");
+      }
+    }
+    if (d.name.empty()) throw std::runtime_error("no name");
+    if (d.match.empty()) throw std::runtime_error("no match");
+    return d;
+  }
+
+  void put32(std::string &out, std::uint32_t v) { out.append(reinterpret_cast<const char *>(&v), sizeof(v)); }
+
+  // An image is a header (magic, version, number of languages, fingerprint)
+  // followed by, per language, its flags, the number of its matches and of
+  // its keywords, then its name, comment delimiters, matches and keywords as
+  // strings ending in '\0', which the editorSyntax points to as they are
+  std::string compile(const std::vector<definition> &definitions, std::uint64_t fingerprint)
+  {
+    std::string out(MAGIC, sizeof(MAGIC));
+    put32(out, KILO_LANGUAGE_CACHE_VERSION);
+    put32(out, static_cast<std::uint32_t>(definitions.size()));
+    out.append(reinterpret_cast<const char *>(&fingerprint), sizeof(fingerprint));
+    for (const auto &d : definitions) {
+      put32(out, d.flags);
+      put32(out, static_cast<std::uint32_t>(d.match.size()));
+      put32(out, static_cast<std::uint32_t>(d.keywords.size()));
+      for (const auto *s : { &d.name, &d.scs, &d.mcs, &d.mce }) out.append(s->c_str(), s->size() + 1);
+      for (const auto &s : d.match) out.append(s.c_str(), s.size() + 1);
+      for (const auto &s : d.keywords) out.append(s.c_str(), s.size() + 1);
+    }
+    return out;
+  }
+
+  // What the image of the definition files depends on: their names, sizes and
+  // modification times, and the layout of the image
+  std::uint64_t fingerprint(const std::vector<std::filesystem::path> &files)
+  {
+    std::uint64_t h = 0xcbf29ce484222325ULL;
+    auto mix = [&](const void *p, std::size_t n) {
+      for (std::size_t i = 0; i < n; i++) h = (h ^ static_cast<const unsigned char *>(p)[i]) * 0x100000001b3ULL;
+    };
+    mix(&KILO_LANGUAGE_CACHE_VERSION, sizeof(KILO_LANGUAGE_CACHE_VERSION));
+    for (const auto &f : files) {
+      std::error_code ec;
+      auto name = f.string();
+      auto size = static_cast<std::uint64_t>(std::filesystem::file_size(f, ec));
+      auto time = static_cast<std::int64_t>(std::filesystem::last_write_time(f, ec).time_since_epoch().count());
+      mix(name.c_str(), name.size() + 1);
+      mix(&size, sizeof(size));
+      mix(&time, sizeof(time));
+    }
+    return h;
+  }
+
+  std::string readFile(const std::filesystem::path &path)
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) throw std::runtime_error("can't read it");
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+  }
+
+}// namespace
+
+registry::registry()
+{
+  for (auto &s : HLDB) add(s);
+}
+
+void registry::add(edit::editorSyntax &s)
+{
+  for (auto **m = s.filematch; m && *m; m++) {
+    auto &table = (*m)[0] == '.' ? byExtension : byName;
+    table.insert_or_assign(*m, &s);
+  }
+  count++;
+}
+
+bool registry::adopt(std::unique_ptr<char[]> image, std::size_t size, std::uint64_t expected)
+{
+  const char *p = image.get();
+  const char *end = p + size;
+  auto get32 = [&](std::uint32_t &v) {
+    if (end - p < 4) return false;
+    memcpy(&v, p, sizeof(v));
+    p += sizeof(v);
+    return true;
+  };
+  auto getString = [&](const char *&s) {
+    auto *nul = static_cast<const char *>(memchr(p, '\0', static_cast<std::size_t>(end - p)));
+    if (!nul) return false;
+    s = p;
+    p = nul + 1;
+    return true;
+  };
+
+  std::uint32_t version = 0, n = 0;
+  std::uint64_t found = 0;
+  if (size < HEADER || memcmp(p, MAGIC, sizeof(MAGIC)) != 0) return false;
+  p += sizeof(MAGIC);
+  get32(version);
+  get32(n);
+  memcpy(&found, p, sizeof(found));
+  p += sizeof(found);
+  if (version != KILO_LANGUAGE_CACHE_VERSION || found != expected) return false;
+
+  // Nothing is added unless the whole image is sound
+  std::deque<language> read;
+  for (std::uint32_t i = 0; i < n; i++) {
+    auto &l = read.emplace_back();
+    std::uint32_t flags = 0, matches = 0, keywords = 0;
+    const char *delimiters[3];
+    if (!get32(flags) || !get32(matches) || !get32(keywords) || !getString(l.syntax.filetype)) return false;
+    for (auto &d : delimiters) {
+      if (!getString(d)) return false;
+    }
+    for (auto *list : { &l.filematch, &l.keywords }) {
+      auto length = list == &l.filematch ? matches : keywords;
+      if (length > static_cast<std::size_t>(end - p)) return false;
+      list->resize(length + 1, nullptr);
+      for (std::uint32_t k = 0; k < length; k++) {
+        if (!getString((*list)[k])) return false;
+      }
+    }
+    l.syntax.filematch = l.filematch.data();
+    l.syntax.keywords = l.keywords.data();
+    l.syntax.singleline_comment_start = *delimiters[0] ? delimiters[0] : nullptr;
+    l.syntax.multiline_comment_start = *delimiters[1] ? delimiters[1] : nullptr;
+    l.syntax.multiline_comment_end = *delimiters[2] ? delimiters[2] : nullptr;
+    l.syntax.flags = static_cast<int>(flags);
+    l.syntax.lexer = nullptr;
+  }
+
+  images.push_back(std::move(image));
+  for (auto &l : read) add(languages.emplace_back(std::move(l)).syntax);
+  return true;
+}
+
+std::size_t registry::load(const std::filesystem::path &dir, const std::filesystem::path &cache)
+{
+  hit = false;
+  problem.clear();
+
+  std::error_code ec;
+  std::vector<std::filesystem::path> files;
+  for (std::filesystem::directory_iterator it(dir, ec), last; !ec && it != last; it.increment(ec)) {
+    if (it->path().extension() == ".syntax" && it->is_regular_file(ec)) files.push_back(it->path());
+  }
+  if (ec) {
+    // Having no definitions is fine
+    if (ec != std::errc::no_such_file_or_directory) problem = dir.string() + ": " + ec.message();
+    return 0;
+  }
+  // Later files win over earlier ones, so the order has to be the same every time
+  std::sort(files.begin(), files.end());
+  auto print = fingerprint(files);
+  auto before = count;
+
+  if (!cache.empty()) {
+    std::ifstream in(cache, std::ios::binary);
+    auto size = std::filesystem::file_size(cache, ec);
+    if (in && !ec) {
+      auto image = std::make_unique<char[]>(size);
+      if (in.read(image.get(), static_cast<std::streamsize>(size)) && adopt(std::move(image), size, print)) {
+        hit = true;
+        return count - before;
+      }
+    }
+  }
+
+  std::vector<definition> definitions;
+  for (const auto &f : files) {
+    try {
+      definitions.push_back(parse(readFile(f)));
+    } catch (const std::runtime_error &e) {
+      if (problem.empty()) problem = f.filename().string() + ": " + e.what();
+    }
+  }
+
+  auto image = compile(definitions, print);
+  auto copy = std::make_unique<char[]>(image.size());
+  memcpy(copy.get(), image.data(), image.size());
+  adopt(std::move(copy), image.size(), print);
+
+  // A cache that would hide a broken file is not written, so that the
+  // problem keeps being reported until it is fixed
+  if (!cache.empty() && problem.empty()) {
+    std::filesystem::create_directories(cache.parent_path(), ec);
+    auto temporary = cache;
+    temporary += ".tmp";
+    {
+      std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+      out.write(image.data(), static_cast<std::streamsize>(image.size()));
+    }
+    std::filesystem::rename(temporary, cache, ec);
+    if (ec) std::filesystem::remove(temporary, ec);
+  }
+  return count - before;
+}
+
+edit::editorSyntax *registry::find(std::string_view filename) const
+{
+  auto slash = filename.rfind('/');
+  auto base = std::string(slash == std::string_view::npos ? filename : filename.substr(slash + 1));
+  if (auto it = byName.find(base); it != byName.end()) return it->second;
+  for (auto dot = base.find('.'); dot != std::string::npos; dot = base.find('.', dot + 1)) {
+    if (auto it = byExtension.find(base.substr(dot)); it != byExtension.end()) return it->second;
+  }
+  return nullptr;
+}
+
+registry &Languages()
+{
+  static registry languages;
+  return languages;
+}
+
+std::string LoadLanguages()
+{
+  auto env = [](const char *name) -> std::filesystem::path {
+    const char *value = std::getenv(name);
+    return value && *value ? value : "";
+  };
+  auto home = env("HOME");
+  auto dir = env("KILO_SYNTAX_DIR");
+  if (dir.empty()) {
+    auto config = env("XDG_CONFIG_HOME");
+    if (config.empty() && !home.empty()) config = home / ".config";
+    if (!config.empty()) dir = config / "kilo/syntax";
+  }
+  if (dir.empty()) return "";
+
+  auto cache = env("XDG_CACHE_HOME");
+  if (cache.empty() && !home.empty()) cache = home / ".cache";
+  if (!cache.empty()) cache /= "kilo/syntax.cache";
+
+  auto &languages = Languages();
+  languages.load(dir, cache);
+  return languages.error();
+}
+
+}// end namespace syntax
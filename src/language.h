@@ -0,0 +1,94 @@
+#pragma once
+
+#include "edit.h"
+
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace syntax {
+
+// Bumped whenever the layout of the cache changes, so old caches are ignored
+const std::uint32_t KILO_LANGUAGE_CACHE_VERSION{ 1 };
+
+// The languages SelectHighlight() can pick from: the built-in ones, and
+// those defined by files in a directory, looked up by the name of a file and
+// by its extensions through hash tables.
+//
+// A definition file is named <anything>.syntax and has a setting per line;
+// blank lines and lines starting with '#' are skipped:
+//
+//   name c
+//   match .c .h .cpp        extensions, or whole file names like Makefile
+//   keywords if while       any number of these lines; a keyword ending in
+//   keywords int| char|     '|' is highlighted as HL_KEYWORD2
+//   comment //
+//   multiline /* */
+//   highlight numbers strings
+//
+// The definitions are compiled into one binary image that strings in the
+// editorSyntax entries point into. The image is written to a cache file and
+// read back from it as long as no definition file changed, so that startup
+// takes one read however many languages there are.
+class registry
+{
+public:
+  // A registry of the built-in languages
+  registry();
+
+  registry(const registry &) = delete;
+  registry &operator=(const registry &) = delete;
+
+  // Adds the languages defined in 'dir', over any of the same name, extension
+  // or file name added before. Uses 'cache' if it is up to date and rewrites
+  // it if not; an empty path does without. Files that can't be read or parsed
+  // are skipped and reported by error(). Returns the number of languages added.
+  std::size_t load(const std::filesystem::path &dir, const std::filesystem::path &cache = {});
+
+  // The language of a file: by its name, then by its extensions, longest
+  // first ("x.tar.gz" tries ".tar.gz", then ".gz"); nullptr if there is none
+  edit::editorSyntax *find(std::string_view filename) const;
+
+  std::size_t size() const { return count; }
+  // Whether the last load() came from the cache
+  bool cached() const { return hit; }
+  // What went wrong with the last load(), if anything
+  const std::string &error() const { return problem; }
+
+private:
+  struct language
+  {
+    edit::editorSyntax syntax;
+    std::vector<const char *> filematch;
+    std::vector<const char *> keywords;
+  };
+
+  void add(edit::editorSyntax &);
+  // Adds the languages in an image made for 'fingerprint'; false if it is
+  // malformed or made for another
+  bool adopt(std::unique_ptr<char[]> image, std::size_t size, std::uint64_t fingerprint);
+
+  std::deque<language> languages{};
+  std::deque<std::unique_ptr<char[]>> images{};
+  std::unordered_map<std::string, edit::editorSyntax *> byName{};
+  std::unordered_map<std::string, edit::editorSyntax *> byExtension{};
+  std::size_t count{};
+  bool hit{ false };
+  std::string problem{};
+};
+
+// The registry of the editor
+registry &Languages();
+
+// Loads the definitions in $KILO_SYNTAX_DIR, or else in
+// $XDG_CONFIG_HOME/kilo/syntax or ~/.config/kilo/syntax, into Languages(),
+// cached in $XDG_CACHE_HOME/kilo/syntax.cache or ~/.cache/kilo/syntax.cache.
+// Returns what went wrong, if anything.
+std::string LoadLanguages();
+
+}// end namespace syntax
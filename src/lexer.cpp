@@ -0,0 +1,189 @@
+#include "lexer.h"
+#include "lineindex.h"
+
+#include <algorithm>
+#include <tuple>
+
+#include <cctype>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KILO_X86 1
+#endif
+
+namespace syntax {
+
+namespace {
+
+  // Appends a run, merging it into the one before if that is of the same
+  // class and ends where it starts
+  inline void emit(std::vector<span> &out, std::size_t start, std::size_t length, unsigned char hl)
+  {
+    if (!out.empty() && out.back().hl == hl && out.back().start + out.back().length == start) {
+      out.back().length += static_cast<std::uint32_t>(length);
+      return;
+    }
+    out.push_back(span{ static_cast<std::uint32_t>(start), static_cast<std::uint32_t>(length), hl });
+  }
+
+#ifdef KILO_X86
+  // Index of the first byte from i on that is no letter, digit or '_', or
+  // no ' ' if 'blank', up to the last 16 bytes of the text
+  __attribute__((target("sse2"))) std::size_t skipSse2(std::string_view text, std::size_t i, bool blank)
+  {
+    const auto *data = text.data();
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i case_bit = _mm_set1_epi8(0x20);
+    const __m128i below_a = _mm_set1_epi8('a' - 1);
+    const __m128i above_z = _mm_set1_epi8('z' + 1);
+    const __m128i below_0 = _mm_set1_epi8('0' - 1);
+    const __m128i above_9 = _mm_set1_epi8('9' + 1);
+    const __m128i underscore = _mm_set1_epi8('_');
+    for (; i + 16 <= text.size(); i += 16) {
+      auto x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+      __m128i in;
+      if (blank) {
+        in = _mm_cmpeq_epi8(x, space);
+      } else {
+        // Bytes from 0x80 up compare as negative, below both ranges
+        auto lower = _mm_or_si128(x, case_bit);
+        auto letter = _mm_and_si128(_mm_cmpgt_epi8(lower, below_a), _mm_cmplt_epi8(lower, above_z));
+        auto digit = _mm_and_si128(_mm_cmpgt_epi8(x, below_0), _mm_cmplt_epi8(x, above_9));
+        in = _mm_or_si128(_mm_or_si128(letter, digit), _mm_cmpeq_epi8(x, underscore));
+      }
+      auto out = ~static_cast<unsigned>(_mm_movemask_epi8(in)) & 0xffff;
+      if (out) return i + static_cast<std::size_t>(__builtin_ctz(out));
+    }
+    return i;
+  }
+#endif
+
+}// namespace
+
+lexer::lexer(const edit::editorSyntax &syntax) : words(syntax.keywords)
+{
+  if (syntax.singleline_comment_start) scs = syntax.singleline_comment_start;
+  // A multi-line comment takes both of its delimiters
+  if (syntax.multiline_comment_start && syntax.multiline_comment_end && *syntax.multiline_comment_start
+      && *syntax.multiline_comment_end) {
+    mcs = syntax.multiline_comment_start;
+    mce = syntax.multiline_comment_end;
+  }
+  numbers = syntax.flags & HL_HIGHLIGHT_NUMBERS;
+  blanks = !words.hasIrregular();
+
+  for (int b = 0; b < 256; b++) {
+    auto c = static_cast<char>(b);
+    if (is_separator(c)) classes[b] |= SEPARATOR;
+    if (c >= '0' && c <= '9') classes[b] |= DIGIT;
+    if ((syntax.flags & HL_HIGHLIGHT_STRINGS) && (c == '"' || c == '\'')) classes[b] |= QUOTE;
+  }
+  for (const auto *delimiter : { &scs, &mcs }) {
+    if (!delimiter->empty()) classes[static_cast<unsigned char>(delimiter->front())] |= DELIMITER;
+  }
+
+  wide = edit::ScannerSupported(edit::scanner::sse2) && !(classes[' '] & STOP);
+  for (int b = 0; b < 256 && wide; b++) {
+    if ((isalnum(b) || b == '_') && (classes[b] & STOP)) wide = false;
+  }
+}
+
+std::size_t lexer::skip(std::string_view text, std::size_t i, bool separators) const
+{
+  auto want = separators ? SEPARATOR : 0;
+#ifdef KILO_X86
+  if (wide) i = skipSse2(text, i, separators);
+#endif
+  while (i < text.size() && (classes[static_cast<unsigned char>(text[i])] & (SEPARATOR | STOP)) == want) i++;
+  return i;
+}
+
+int lexer::run(std::string_view text, int in_comment, std::vector<span> &out) const
+{
+  const char *p = text.data();
+  auto n = text.size();
+  auto prev_sep = true;
+  auto number = false;// the byte before is part of a number
+
+  std::size_t i = 0;
+  while (i < n) {
+    if (in_comment && !mcs.empty()) {
+      auto end = text.find(mce, i);
+      if (end == std::string_view::npos) {
+        emit(out, i, n - i, HL_MLCOMMENT);
+        break;
+      }
+      end += mce.size();
+      emit(out, i, end - i, HL_MLCOMMENT);
+      i = end;
+      in_comment = 0;
+      prev_sep = true;
+      number = false;
+      continue;
+    }
+
+    auto c = p[i];
+    auto cls = classes[static_cast<unsigned char>(c)];
+
+    if (cls & STOP) {
+      if (!scs.empty() && !in_comment && text.compare(i, scs.size(), scs) == 0) {
+        emit(out, i, n - i, HL_COMMENT);
+        break;
+      }
+      if (!mcs.empty() && text.compare(i, mcs.size(), mcs) == 0) {
+        emit(out, i, std::min(mcs.size(), n - i), HL_MLCOMMENT);
+        i += mcs.size();
+        in_comment = 1;
+        number = false;
+        continue;
+      }
+      if (cls & QUOTE) {
+        // A backslash escapes the byte after it, if there is one
+        auto end = i + 1;
+        while (end < n && p[end] != c) end += (p[end] == '\\' && end + 1 < n) ? 2 : 1;
+        if (end < n) {
+          end++;
+          prev_sep = true;
+        }
+        emit(out, i, end - i, HL_STRING);
+        i = end;
+        number = false;
+        continue;
+      }
+    }
+
+    if (numbers && (((cls & DIGIT) && (prev_sep || number)) || (c == '.' && number))) {
+      emit(out, i, 1, HL_NUMBER);
+      i++;
+      number = true;
+      prev_sep = false;
+      continue;
+    }
+    number = false;
+
+    if (prev_sep) {
+      // Look the token starting here up as a whole
+      auto end = i;
+      while (!(classes[static_cast<unsigned char>(p[end])] & SEPARATOR)) end++;
+      auto length = end - i;
+      auto hl = words.find(std::string_view(p + i, length));
+      if (hl == HL_NORMAL && words.hasIrregular()) std::tie(length, hl) = words.findIrregular(p + i);
+      if (hl != HL_NORMAL) {
+        emit(out, i, length, hl);
+        i += length;
+        prev_sep = false;
+        continue;
+      }
+    }
+
+    prev_sep = cls & SEPARATOR;
+    i++;
+    // What follows in the same word, or the same run of separators, can't
+    // start anything
+    if (!prev_sep || blanks) i = skip(text, i, prev_sep);
+  }
+
+  return in_comment;
+}
+
+}// end namespace syntax
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "syntax.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace syntax {
+
+// A run of characters of one highlight class
+using span = edit::hlSpan;
+
+// The highlighting rules of a syntax, compiled: a table with the class of
+// every byte, so that each is looked at with one load instead of calls to
+// isdigit(), isspace() and strchr(), and the keywordTable. Rows are lexed into
+// runs rather than a class per byte, and plain words and blanks are skipped
+// 16 bytes at a time where the CPU allows.
+class lexer
+{
+public:
+  explicit lexer(const edit::editorSyntax &);
+
+  // Lexes text, which must be followed by a '\0' as erow::render() is, given
+  // whether a multi-line comment is open at its start. Appends its runs of
+  // classes other than HL_NORMAL to 'out', in order and with neighbours of
+  // the same class merged, and returns whether a comment is open at its end.
+  int run(std::string_view text, int in_comment, std::vector<span> &out) const;
+
+  const keywordTable &keywords() const { return words; }
+
+private:
+  enum : std::uint8_t {
+    SEPARATOR = 1 << 0,
+    DIGIT = 1 << 1,
+    QUOTE = 1 << 2,// starts a string, if strings are highlighted
+    DELIMITER = 1 << 3,// first byte of a comment delimiter
+    STOP = QUOTE | DELIMITER,
+  };
+
+  // Index of the first byte from i on that is not part of a plain word, or
+  // of a run of separators if 'separators'
+  std::size_t skip(std::string_view text, std::size_t i, bool separators) const;
+
+  std::array<std::uint8_t, 256> classes{};
+  keywordTable words;
+  std::string scs{};
+  std::string mcs{};
+  std::string mce{};
+  bool numbers{};
+  // Separators can only be skipped without a keyword lookup at each when no
+  // keyword has a separator in it
+  bool blanks{};
+  // Words are skipped 16 bytes at a time when no comment starts with a letter,
+  // digit or '_', and blanks when none starts with ' '
+  bool wide{};
+};
+
+}// end namespace syntax
@@ -0,0 +1,163 @@
+#include "lineindex.h"
+
+#include <algorithm>
+#include <limits>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KILO_X86 1
+#endif
+
+namespace edit {
+
+/*** newline scanning ***/
+
+namespace {
+
+  void scanScalar(const char *data, std::size_t len, std::size_t base, std::vector<std::size_t> &out)
+  {
+    for (std::size_t i = 0; i < len; i++) {
+      if (data[i] == '\n') out.push_back(base + i);
+    }
+  }
+
+#ifdef KILO_X86
+  // Compares 16 or 32 bytes at a time against '\n' and walks the set bits of
+  // the resulting mask, so lines cost one bit-scan each instead of a branch
+  // per byte.
+  __attribute__((target("sse2"))) void
+    scanSse2(const char *data, std::size_t len, std::size_t base, std::vector<std::size_t> &out)
+  {
+    const __m128i nl = _mm_set1_epi8('\n');
+    std::size_t i = 0;
+    for (; i + 16 <= len; i += 16) {
+      auto chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+      auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl)));
+      while (mask) {
+        out.push_back(base + i + static_cast<std::size_t>(__builtin_ctz(mask)));
+        mask &= mask - 1;
+      }
+    }
+    scanScalar(data + i, len - i, base + i, out);
+  }
+
+  __attribute__((target("avx2"))) void
+    scanAvx2(const char *data, std::size_t len, std::size_t base, std::vector<std::size_t> &out)
+  {
+    const __m256i nl = _mm256_set1_epi8('\n');
+    std::size_t i = 0;
+    for (; i + 32 <= len; i += 32) {
+      auto chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+      auto mask = static_cast<unsigned>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, nl)));
+      while (mask) {
+        out.push_back(base + i + static_cast<std::size_t>(__builtin_ctz(mask)));
+        mask &= mask - 1;
+      }
+    }
+    scanScalar(data + i, len - i, base + i, out);
+  }
+#endif
+
+  scanner detect()
+  {
+#ifdef KILO_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return scanner::avx2;
+    if (__builtin_cpu_supports("sse2")) return scanner::sse2;
+#endif
+    return scanner::scalar;
+  }
+
+}// namespace
+
+bool ScannerSupported(scanner s)
+{
+  static const scanner best = detect();
+  return s == scanner::automatic || s == scanner::scalar || (s == scanner::sse2 && best != scanner::scalar)
+         || (s == scanner::avx2 && best == scanner::avx2);
+}
+
+void ScanNewlines(const char *data, std::size_t len, std::size_t base, std::vector<std::size_t> &out, scanner s)
+{
+  static const scanner best = detect();
+  if (s == scanner::automatic || !ScannerSupported(s)) s = best;
+
+  switch (s) {
+#ifdef KILO_X86
+  case scanner::avx2:
+    scanAvx2(data, len, base, out);
+    break;
+  case scanner::sse2:
+    scanSse2(data, len, base, out);
+    break;
+#endif
+  default:
+    scanScalar(data, len, base, out);
+    break;
+  }
+}
+
+/*** line index ***/
+
+const std::size_t BLOCK_LINES{ 64 };
+const std::uint32_t FAR{ std::numeric_limits<std::uint32_t>::max() };
+
+void lineIndex::push(std::size_t start, bool cr)
+{
+  if (count % BLOCK_LINES == 0) {
+    bases.push_back(start);
+    crlf.push_back(0);
+  }
+  auto delta = start - bases.back();
+  if (delta >= FAR) {
+    offsets.push_back(FAR);
+    far.emplace_back(count, start);
+  } else {
+    offsets.push_back(static_cast<std::uint32_t>(delta));
+  }
+  if (cr) crlf.back() |= std::uint64_t{ 1 } << (count % BLOCK_LINES);
+  count++;
+}
+
+void lineIndex::newline(std::size_t pos, bool cr)
+{
+  push(end, cr);
+  end = pos + 1;
+}
+
+void lineIndex::finish(std::size_t length)
+{
+  if (end < length) {
+    push(end, false);
+    end = length + 1;
+  }
+}
+
+std::size_t lineIndex::start(std::size_t n) const
+{
+  if (n == count) return end;
+  if (offsets[n] == FAR) {
+    auto it = std::lower_bound(far.begin(), far.end(), n, [](const auto &f, std::size_t k) { return f.first < k; });
+    return it->second;
+  }
+  return bases[n / BLOCK_LINES] + offsets[n];
+}
+
+std::size_t lineIndex::length(std::size_t n) const
+{
+  auto cr = (crlf[n / BLOCK_LINES] >> (n % BLOCK_LINES)) & 1;
+  return start(n + 1) - start(n) - 1 - cr;
+}
+
+lineIndex IndexLines(const char *data, std::size_t len)
+{
+  std::vector<std::size_t> found;
+  ScanNewlines(data, len, 0, found);
+
+  lineIndex index;
+  for (auto pos : found) index.newline(pos, pos > 0 && data[pos - 1] == '\r');
+  index.finish(len);
+  return index;
+}
+
+}// end namespace edit
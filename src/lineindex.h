@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+namespace edit {
+
+enum class scanner { automatic, scalar, sse2, avx2 };
+
+// Appends base + the offset of every '\n' in [data, data + len) to 'out'.
+// 'automatic' picks the widest implementation the CPU supports.
+void ScanNewlines(const char *data,
+  std::size_t len,
+  std::size_t base,
+  std::vector<std::size_t> &out,
+  scanner s = scanner::automatic);
+bool ScannerSupported(scanner s);
+
+// Start offsets of the lines of a text, stored compactly: a 64-bit base for
+// every block of 64 lines, a 32-bit offset from that base for every line and
+// one bit per line telling whether it ends in "\r\n".
+class lineIndex
+{
+public:
+  // Records a line ending with the '\n' at 'pos'
+  void newline(std::size_t pos, bool crlf);
+  // Records the end of the text; a last line without '\n' is counted too
+  void finish(std::size_t length);
+
+  std::size_t lines() const { return count; }
+  std::size_t start(std::size_t n) const;
+  // Length of line n without its line terminator
+  std::size_t length(std::size_t n) const;
+
+private:
+  void push(std::size_t start, bool crlf);
+
+  std::vector<std::uint64_t> bases{};
+  std::vector<std::uint32_t> offsets{};
+  std::vector<std::pair<std::size_t, std::uint64_t>> far{};// starts too far from their base
+  std::vector<std::uint64_t> crlf{};
+  std::size_t count{};
+  std::size_t end{};// one past the last line's terminator
+};
+
+// Builds the index of a whole text in memory
+lineIndex IndexLines(const char *data, std::size_t len);
+
+}// end namespace edit
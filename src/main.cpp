@@ -1,12 +1,26 @@
 /*** includes ***/
 
 #include "edit.h"
+#include "events.h"
+#include "language.h"
+#include "output.h"
+#include "syntax.h"
 #include "terminal.h"
 #include "tui.h"
 
+#include <chrono>
+#include <csignal>
+#include <ctime>
+#include <functional>
+
 
 /*** defines ***/
 
+// Rows highlighted per idle slice, about a millisecond's worth
+const std::size_t KILO_IDLE_ROWS{ 2048 };
+// How long a status message stays up
+const time_t KILO_STATUS_SECONDS{ 5 };
+
 
 using Term::Terminal;
 using Term::cursor_on;
@@ -26,19 +40,111 @@ int main(int argc, char *argv[])
   try {
     Terminal term(true, false);
     term.save_screen();
-    tui::init(edit::referenceToE(), term);
-    if (argc >= 2) { edit::Open(argv[1]); }
-    tui::SetStatusMessage(edit::referenceToE(), "HELP: Ctrl-S = save | Ctrl - Q = quit | Ctrl-F = find");
-
+    term.enable_bracketed_paste();
+    output::writer out(STDOUT_FILENO);
+    auto &E = edit::referenceToE();
     std::string ab;
     ab.reserve(16 * 1024);
 
-    tui::RefreshScreen(edit::referenceToE(), ab);
-    term.write(ab);
-    while (tui::ProcessKeypress(edit::referenceToE(), term)) {
-      tui::RefreshScreen(edit::referenceToE(), ab);
-      term.write(ab);
-    }
+    // SIGWINCH has to be blocked before Open() starts any threads
+    events::eventLoop events;
+
+    // A frame the terminal couldn't take at once is finished whenever stdout
+    // can be written to again. Frames asked for meanwhile aren't drawn, only
+    // the state at the end is, once the terminal has caught up.
+    bool draining = false, stale = false;
+    auto present = [&] {
+      if (out.busy()) {
+        stale = true;
+        return;
+      }
+      tui::Present(E, ab);
+      if (!out.busy() || draining) return;
+      draining = true;
+      events.writable(out.descriptor(), [&] {
+        if (out.flush() && stale) {
+          stale = false;
+          tui::Present(E, ab);
+        }
+        draining = out.busy();
+        return draining;
+      });
+    };
+
+    events.signal(SIGWINCH, [&] {
+      tui::Resize(E, term);
+      present();
+    });
+
+    tui::init(E, term, out);
+    // Before a file is opened, so that it can be highlighted by them
+    auto problem = syntax::LoadLanguages();
+    if (argc >= 2) { edit::Open(argv[1]); }
+    tui::SetStatusMessage(E, "HELP: ^S save | ^Q quit | ^F find | ^R replace | ^U undo | ^Y redo");
+    if (!problem.empty()) tui::SetStatusMessage(E, ("Syntax definitions: " + problem).c_str());
+
+    // Take the status message down once it has been shown long enough, with a
+    // timer that is only there while a message is
+    bool expiring = false;
+    std::function<void()> expire = [&] {
+      if (expiring || E.statusmsg[0] == '\0') return;
+      expiring = true;
+      auto left = E.statusmsg_time + KILO_STATUS_SECONDS - time(nullptr);
+      events.every(std::chrono::seconds(std::max<time_t>(left, 0)), [&] {
+        expiring = false;
+        if (E.statusmsg[0] != '\0' && time(nullptr) - E.statusmsg_time >= KILO_STATUS_SECONDS) {
+          E.statusmsg[0] = '\0';
+          present();
+        }
+        // A message put up meanwhile has a time of its own
+        expire();
+        return false;
+      });
+    };
+
+    // Show the progress of work going on in the background, like the line
+    // count growing while a large file is indexed or a save being written,
+    // for as long as there is any
+    bool ticking = false;
+    auto progress = [&] {
+      if (ticking) return;
+      ticking = true;
+      events.every(std::chrono::milliseconds(200), [&] {
+        ticking = tui::Background(E);
+        present();
+        expire();
+        return ticking;
+      });
+    };
+
+    events.watch(STDIN_FILENO, [&] {
+      // Keys that arrived together are all handled before drawing again
+      do {
+        if (!tui::ProcessKeypress(E, term)) {
+          events.stop();
+          return;
+        }
+      } while (term.input_pending());
+      if (tui::Background(E)) progress();
+      present();
+      expire();
+    });
+    progress();
+
+    // Bring the highlighting watermark up to date between keystrokes, and
+    // redraw if that changed rows on screen
+    events.idle([&] {
+      auto before = E.hl_valid;
+      bool more = syntax::Advance(E, KILO_IDLE_ROWS);
+      auto bottom = E.rowoff + static_cast<std::size_t>(E.screenrows);
+      if (E.hl_valid > before && before < bottom && E.hl_valid > E.rowoff) present();
+      return more;
+    });
+
+    present();
+    expire();
+    events.run();
+    tui::Wait(E);
   } catch (const std::runtime_error &re) {
     std::cerr << "Runtime error: " << re.what() << std::endl;
     return 2;
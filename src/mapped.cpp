@@ -0,0 +1,101 @@
+#include "mapped.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace edit {
+
+// The indexer publishes offsets (and releases scanned pages) per block
+const std::size_t INDEX_BLOCK{ 1 << 20 };
+
+mappedFile::mappedFile(const char *filename)
+{
+  int fd = open(filename, O_RDONLY);
+  if (fd == -1) throw std::runtime_error("File failed to open.");
+
+  struct stat st;
+  if (fstat(fd, &st) == -1) {
+    close(fd);
+    throw std::runtime_error("File failed to open.");
+  }
+  length = static_cast<std::size_t>(st.st_size);
+
+  if (length > 0) {
+    void *p = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      close(fd);
+      throw std::runtime_error("File failed to map.");
+    }
+    madvise(p, length, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(p);
+  }
+  close(fd);
+
+  indexer = std::thread(&mappedFile::scan, this);
+}
+
+mappedFile::~mappedFile()
+{
+  stop = true;
+  if (indexer.joinable()) indexer.join();
+  if (data) munmap(const_cast<char *>(data), length);
+}
+
+void mappedFile::scan()
+{
+  std::vector<std::size_t> found;
+  std::size_t pos = 0;
+  auto page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+
+  while (pos < length && !stop) {
+    auto end = std::min(pos + INDEX_BLOCK, length);
+    ScanNewlines(data + pos, end - pos, pos, found);
+
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      for (auto nl : found) index.newline(nl, nl > 0 && data[nl - 1] == '\r');
+    }
+    cv.notify_all();
+    found.clear();
+
+    // The scanned pages are only needed again for lines that get viewed, so
+    // let the kernel drop them instead of charging them to our RSS.
+    auto from = pos / page * page;
+    auto to = end / page * page;
+    if (to > from) madvise(const_cast<char *>(data) + from, to - from, MADV_DONTNEED);
+    pos = end;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    index.finish(length);
+    done = true;
+  }
+  cv.notify_all();
+}
+
+std::size_t mappedFile::lines() const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return index.lines();
+}
+
+void mappedFile::wait(std::size_t n) const
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&] { return done.load() || index.lines() >= n; });
+}
+
+std::string_view mappedFile::line(std::size_t n) const
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  return { data + index.start(n), index.length(n) };
+}
+
+}// end namespace edit
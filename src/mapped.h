@@ -0,0 +1,52 @@
+#pragma once
+
+#include "lineindex.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+namespace edit {
+
+// A read-only memory mapping of a file whose line offsets are found by a
+// background thread. Lines can be read as soon as they have been indexed,
+// without copying the file into memory first.
+class mappedFile
+{
+public:
+  explicit mappedFile(const char *filename);
+  ~mappedFile();
+
+  mappedFile(const mappedFile &) = delete;
+  mappedFile &operator=(const mappedFile &) = delete;
+
+  std::size_t size() const { return length; }
+
+  // Number of lines indexed so far
+  std::size_t lines() const;
+  // True once the whole file has been indexed
+  bool indexed() const { return done.load(); }
+  // Blocks until at least n lines are indexed or indexing has finished
+  void wait(std::size_t n) const;
+
+  // Line n without its line terminator; n must be smaller than lines()
+  std::string_view line(std::size_t n) const;
+
+private:
+  void scan();
+
+  const char *data{ nullptr };
+  std::size_t length{};
+
+  mutable std::mutex mutex{};
+  mutable std::condition_variable cv{};
+  lineIndex index{};
+  std::atomic<bool> done{ false };
+  std::atomic<bool> stop{ false };
+  std::thread indexer{};
+};
+
+}// end namespace edit
@@ -0,0 +1,77 @@
+#include "output.h"
+
+#include <cerrno>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+namespace output {
+
+writer::writer(int to)
+{
+  // O_NONBLOCK belongs to the open file description, which a terminal's
+  // stdout shares with stdin, stderr and the shell. The device is opened
+  // again instead, for a description only the writer uses.
+  std::string path;
+  if (const char *name = isatty(to) ? ttyname(to) : nullptr) {
+    path = name;
+  } else {
+    path = "/proc/self/fd/" + std::to_string(to);
+  }
+  fd = open(path.c_str(), O_WRONLY | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1) throw std::runtime_error("can't open " + path);
+}
+
+writer::~writer()
+{
+  try {
+    while (!flush()) {
+      struct pollfd p{ fd, POLLOUT, 0 };
+      if (poll(&p, 1, -1) == -1 && errno != EINTR) break;
+    }
+  } catch (const std::runtime_error &) {
+    // The terminal is gone; there is nobody left to show the frame to
+  }
+  close(fd);
+}
+
+void writer::submit(std::string &ab)
+{
+  if (busy()) throw std::logic_error("writer::submit() while busy");
+  pending.swap(ab);
+  sent = 0;
+  flush();
+}
+
+bool writer::flush()
+{
+  while (busy()) {
+    auto n = ::write(fd, pending.data() + sent, pending.size() - sent);
+    if (n == -1) {
+      if (errno == EINTR) continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK) return false;
+      throw std::runtime_error("write() failed");
+    }
+    sent += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+bool writer::wait(int input)
+{
+  while (!flush()) {
+    struct pollfd p[2] = { { fd, POLLOUT, 0 }, { input, POLLIN, 0 } };
+    if (poll(p, 2, -1) == -1) {
+      if (errno == EINTR) continue;
+      throw std::runtime_error("poll() failed");
+    }
+    if (p[1].revents & POLLIN) return true;
+  }
+  return false;
+}
+
+}// end namespace output
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace output {
+
+// Writes frames to a file descriptor without blocking, so that a slow
+// terminal never stalls the editor. A frame that can't be written at
+// once is kept and finished later with flush(); meanwhile the caller can
+// skip drawing new frames, which only the newest state would survive anyway.
+class writer
+{
+public:
+  // Writes to what 'to' refers to, through a descriptor of its own: 'to'
+  // itself is left blocking
+  explicit writer(int to);
+  // Writes what is left, waiting for as long as that takes
+  ~writer();
+
+  writer(const writer &) = delete;
+  writer &operator=(const writer &) = delete;
+
+  // True while part of the last frame hasn't been written yet
+  bool busy() const { return sent < pending.size(); }
+  // Queues ab, which must only be submitted when not busy, and writes as much
+  // of it as possible. The buffers are swapped, so ab keeps being reused.
+  void submit(std::string &ab);
+  // Writes as much as possible without blocking; returns !busy()
+  bool flush();
+  // Blocks until the frame has been written or 'input' has data to read.
+  // Returns true in the latter case.
+  bool wait(int input);
+  // The descriptor written to, to poll for POLLOUT while busy()
+  int descriptor() const { return fd; }
+
+private:
+  int fd;
+  std::string pending{};
+  std::size_t sent{};
+};
+
+}// end namespace output
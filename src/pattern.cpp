@@ -0,0 +1,581 @@
+#include "pattern.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <stdexcept>
+#include <utility>
+
+namespace search {
+
+// Longest program a pattern may compile to; counted repetitions make copies
+const std::size_t PATTERN_MAX_PROGRAM{ 20000 };
+// A DFA is rebuilt from scratch once it has this many states
+const std::size_t PATTERN_MAX_STATES{ 2048 };
+
+using charset = std::bitset<256>;
+
+struct pattern::program
+{
+  enum op : std::uint8_t { SET, SPLIT, JUMP, BOL, EOL, MATCH };
+  struct inst
+  {
+    op code;
+    std::int32_t x;// SET: index into sets; SPLIT, JUMP: target
+    std::int32_t y;// SPLIT: second target
+  };
+
+  std::vector<inst> code{};
+  std::vector<charset> sets{};
+  // Bytes no set tells apart share a class, and DFA tables have a column
+  // per class instead of one per byte
+  std::array<std::uint8_t, 256> cls{};
+  std::size_t classes{};
+  // A string every match contains, or empty
+  std::string literal{};
+};
+
+/*** parsing ***/
+
+namespace {
+
+  struct node
+  {
+    enum kind { EMPTY, SET, BOL, EOL, CAT, ALT, REPEAT };
+
+    kind k{ EMPTY };
+    charset set{};
+    int min{};
+    int max{};// -1 for no limit
+    std::vector<node> kids{};
+  };
+
+  [[noreturn]] void fail(const char *what) { throw std::runtime_error(what); }
+
+  class parser
+  {
+  public:
+    explicit parser(std::string_view s) : src(s) {}
+
+    node parse()
+    {
+      auto n = alternation();
+      if (pos < src.size()) fail("unmatched )");
+      return n;
+    }
+
+  private:
+    bool more() const { return pos < src.size(); }
+    char peek() const { return src[pos]; }
+
+    node alternation()
+    {
+      auto first = concatenation();
+      if (!more() || peek() != '|') return first;
+      node n{ node::ALT };
+      n.kids.push_back(std::move(first));
+      while (more() && peek() == '|') {
+        pos++;
+        n.kids.push_back(concatenation());
+      }
+      return n;
+    }
+
+    node concatenation()
+    {
+      node n{ node::CAT };
+      while (more() && peek() != '|' && peek() != ')') {
+        auto k = repetition();
+        if (k.k == node::CAT) {
+          // A group in a concatenation: keep it flat, so that literal runs
+          // across groups are found
+          for (auto &g : k.kids) n.kids.push_back(std::move(g));
+        } else {
+          n.kids.push_back(std::move(k));
+        }
+      }
+      if (n.kids.size() == 1) return std::move(n.kids[0]);
+      return n;
+    }
+
+    node repetition()
+    {
+      auto n = atom();
+      while (more()) {
+        int min, max;
+        std::size_t length = 1;
+        auto c = peek();
+        if (c == '*') {
+          min = 0, max = -1;
+        } else if (c == '+') {
+          min = 1, max = -1;
+        } else if (c == '?') {
+          min = 0, max = 1;
+        } else if (c != '{' || (length = counted(min, max)) == 0) {
+          break;
+        }
+        pos += length;
+        if (n.k == node::BOL || n.k == node::EOL) fail("nothing to repeat");
+        node r{ node::REPEAT };
+        r.min = min;
+        r.max = max;
+        r.kids.push_back(std::move(n));
+        n = std::move(r);
+      }
+      return n;
+    }
+
+    // The counted repetition starting with the '{' at pos: {m} for exactly m
+    // times, {m,} for m times or more, {m,n} for m to n times. Returns its
+    // length without consuming it, or 0 if the '{' starts none of these, as
+    // in "{", "{,2}", "{x}" or "{3,1}"; such a '{' is a literal character. A
+    // count over 1000 is an error.
+    std::size_t counted(int &min, int &max) const
+    {
+      auto at = pos + 1;
+      auto number = [&](int &v) {
+        auto start = at;
+        v = 0;
+        while (at < src.size() && src[at] >= '0' && src[at] <= '9') {
+          v = v * 10 + (src[at] - '0');
+          if (v > 1000) fail("repetition count too large");
+          at++;
+        }
+        return at > start;
+      };
+      if (!number(min)) return 0;
+      max = min;
+      if (at < src.size() && src[at] == ',') {
+        at++;
+        if (!number(max)) max = -1;
+      }
+      if (at >= src.size() || src[at] != '}' || (max != -1 && max < min)) return 0;
+      return at + 1 - pos;
+    }
+
+    node atom()
+    {
+      auto c = src[pos++];
+      node n{ node::SET };
+      switch (c) {
+      case '(':
+        n = alternation();
+        if (!more() || peek() != ')') fail("missing )");
+        pos++;
+        return n;
+      case '[':
+        n.set = bracket();
+        return n;
+      case '.':
+        n.set.set();
+        return n;
+      case '^':
+        return node{ node::BOL };
+      case '$':
+        return node{ node::EOL };
+      case '\\':
+        n.set = escape();
+        return n;
+      case '*':
+      case '+':
+      case '?':
+        fail("nothing to repeat");
+      default:
+        n.set.set(static_cast<unsigned char>(c));
+        return n;
+      }
+    }
+
+    charset escape()
+    {
+      if (!more()) fail("trailing \\");
+      auto c = src[pos++];
+      charset s;
+      auto range = [&](char a, char b) {
+        for (int i = static_cast<unsigned char>(a); i <= static_cast<unsigned char>(b); i++) s.set(static_cast<std::size_t>(i));
+      };
+      switch (c) {
+      case 'd':
+      case 'D':
+        range('0', '9');
+        break;
+      case 'w':
+      case 'W':
+        range('0', '9');
+        range('a', 'z');
+        range('A', 'Z');
+        s.set('_');
+        break;
+      case 's':
+      case 'S':
+        for (char w : { ' ', '\t', '\n', '\r', '\v', '\f' }) s.set(static_cast<unsigned char>(w));
+        break;
+      case 't':
+        s.set('\t');
+        return s;
+      default:
+        if (std::isalnum(static_cast<unsigned char>(c))) fail("unknown escape");
+        s.set(static_cast<unsigned char>(c));
+        return s;
+      }
+      if (std::isupper(static_cast<unsigned char>(c))) s.flip();
+      return s;
+    }
+
+    charset bracket()
+    {
+      charset s;
+      bool negate = more() && peek() == '^';
+      if (negate) pos++;
+      bool first = true;
+      while (true) {
+        if (!more()) fail("missing ]");
+        auto c = src[pos++];
+        if (c == ']' && !first) break;
+        first = false;
+        charset one;
+        if (c == '\\') {
+          one = escape();
+        } else if (pos + 1 < src.size() && peek() == '-' && src[pos + 1] != ']') {
+          auto hi = src[pos + 1];
+          pos += 2;
+          if (static_cast<unsigned char>(hi) < static_cast<unsigned char>(c)) fail("bad range");
+          for (int i = static_cast<unsigned char>(c); i <= static_cast<unsigned char>(hi); i++) one.set(static_cast<std::size_t>(i));
+        } else {
+          one.set(static_cast<unsigned char>(c));
+        }
+        s |= one;
+      }
+      if (negate) s.flip();
+      return s;
+    }
+
+    std::string_view src;
+    std::size_t pos{};
+  };
+
+  /*** compiling ***/
+
+  class compiler
+  {
+  public:
+    explicit compiler(pattern::program &p) : prog(p) {}
+
+    void emit(const node &n)
+    {
+      if (prog.code.size() > PATTERN_MAX_PROGRAM) fail("pattern too large");
+      switch (n.k) {
+      case node::EMPTY:
+        break;
+      case node::SET:
+        add(pattern::program::SET, set(n.set));
+        break;
+      case node::BOL:
+        add(pattern::program::BOL);
+        break;
+      case node::EOL:
+        add(pattern::program::EOL);
+        break;
+      case node::CAT:
+        for (const auto &k : n.kids) emit(k);
+        break;
+      case node::ALT: {
+        // SPLIT to each alternative in turn, each JUMPing past the rest
+        std::vector<std::size_t> jumps;
+        for (std::size_t i = 0; i < n.kids.size(); i++) {
+          std::size_t split = 0;
+          if (i + 1 < n.kids.size()) split = add(pattern::program::SPLIT, here() + 1);
+          emit(n.kids[i]);
+          if (i + 1 < n.kids.size()) {
+            jumps.push_back(add(pattern::program::JUMP));
+            prog.code[split].y = here();
+          }
+        }
+        for (auto j : jumps) prog.code[j].x = here();
+        break;
+      }
+      case node::REPEAT:
+        for (int i = 0; i < n.min; i++) emit(n.kids[0]);
+        if (n.max == -1) {
+          auto loop = add(pattern::program::SPLIT, here() + 1);
+          emit(n.kids[0]);
+          add(pattern::program::JUMP, static_cast<std::int32_t>(loop));
+          prog.code[loop].y = here();
+        } else {
+          for (int i = n.min; i < n.max; i++) {
+            auto skip = add(pattern::program::SPLIT, here() + 1);
+            emit(n.kids[0]);
+            prog.code[skip].y = here();
+          }
+        }
+        break;
+      }
+    }
+
+    std::int32_t here() const { return static_cast<std::int32_t>(prog.code.size()); }
+
+    std::size_t add(pattern::program::op code, std::int32_t x = 0, std::int32_t y = 0)
+    {
+      prog.code.push_back(pattern::program::inst{ code, x, y });
+      return prog.code.size() - 1;
+    }
+
+  private:
+    std::int32_t set(const charset &s)
+    {
+      auto it = std::find(prog.sets.begin(), prog.sets.end(), s);
+      if (it == prog.sets.end()) it = prog.sets.insert(it, s);
+      return static_cast<std::int32_t>(it - prog.sets.begin());
+    }
+
+    pattern::program &prog;
+  };
+
+  // Gives bytes that are in the same sets the same class
+  void classify(pattern::program &p)
+  {
+    std::map<std::vector<bool>, std::uint8_t> seen;
+    std::vector<bool> in(p.sets.size());
+    for (std::size_t b = 0; b < 256; b++) {
+      for (std::size_t i = 0; i < p.sets.size(); i++) in[i] = p.sets[i][b];
+      auto [it, added] = seen.emplace(in, static_cast<std::uint8_t>(seen.size()));
+      p.cls[b] = it->second;
+    }
+    p.classes = seen.size();
+  }
+
+  // Adds the SET, EOL and MATCH positions reachable from pc without reading
+  // a byte. BOL is passed only at the start of a row, EOL only at its end.
+  void closure(const pattern::program &p,
+    std::int32_t pc,
+    bool at_start,
+    bool at_end,
+    std::vector<std::int32_t> &out,
+    std::vector<std::uint32_t> &mark,
+    std::uint32_t gen,
+    std::vector<std::int32_t> &stack)
+  {
+    stack.push_back(pc);
+    while (!stack.empty()) {
+      pc = stack.back();
+      stack.pop_back();
+      auto i = static_cast<std::size_t>(pc);
+      if (mark[i] == gen) continue;
+      mark[i] = gen;
+      const auto &in = p.code[i];
+      switch (in.code) {
+      case pattern::program::SPLIT:
+        stack.push_back(in.y);
+        stack.push_back(in.x);
+        break;
+      case pattern::program::JUMP:
+        stack.push_back(in.x);
+        break;
+      case pattern::program::BOL:
+        if (at_start) stack.push_back(pc + 1);
+        break;
+      case pattern::program::EOL:
+        if (at_end) {
+          stack.push_back(pc + 1);
+        } else {
+          out.push_back(pc);
+        }
+        break;
+      default:
+        out.push_back(pc);
+        break;
+      }
+    }
+  }
+
+  // Sets 'best' to the longest run of single bytes that every match of n
+  // contains, if longer than what it holds
+  void requiredLiteral(const node &n, std::string &best)
+  {
+    auto single = [](const node &k) { return k.k == node::SET && k.set.count() == 1; };
+    auto byte = [](const node &k) {
+      std::size_t b = 0;
+      while (!k.set[b]) b++;
+      return static_cast<char>(b);
+    };
+    if (single(n)) {
+      if (best.empty()) best = byte(n);
+    } else if (n.k == node::REPEAT && n.min > 0) {
+      requiredLiteral(n.kids[0], best);
+    } else if (n.k == node::CAT) {
+      std::string run;
+      for (const auto &k : n.kids) {
+        if (single(k)) {
+          run += byte(k);
+          continue;
+        }
+        if (run.size() > best.size()) best = run;
+        run.clear();
+        requiredLiteral(k, best);
+      }
+      if (run.size() > best.size()) best = run;
+    }
+  }
+
+  // The pattern that matches the reverse of what n matches; '^' and '$'
+  // trade places, as the reversed row is read from its end
+  node reverse(node n)
+  {
+    if (n.k == node::CAT) std::reverse(n.kids.begin(), n.kids.end());
+    if (n.k == node::BOL) n.k = node::EOL;
+    else if (n.k == node::EOL) n.k = node::BOL;
+    for (auto &k : n.kids) k = reverse(std::move(k));
+    return n;
+  }
+
+  std::shared_ptr<const pattern::program> compile(const node &tree)
+  {
+    auto p = std::make_shared<pattern::program>();
+    compiler c(*p);
+    c.emit(tree);
+    c.add(pattern::program::MATCH);
+    if (p->code.size() > PATTERN_MAX_PROGRAM) fail("pattern too large");
+    classify(*p);
+    requiredLiteral(tree, p->literal);
+    return p;
+  }
+
+}// namespace
+
+/*** matching ***/
+
+namespace {
+
+  std::pair<std::shared_ptr<const pattern::program>, std::shared_ptr<const pattern::program>> compile(std::string_view expression)
+  {
+    auto tree = parser(expression).parse();
+    auto forward = compile(tree);
+    return { forward, compile(reverse(std::move(tree))) };
+  }
+
+}// namespace
+
+pattern::pattern(std::string_view expression) : pattern(compile(expression)) {}
+
+pattern::pattern(std::pair<std::shared_ptr<const program>, std::shared_ptr<const program>> programs)
+  : prog(std::move(programs.first)), reversed(std::move(programs.second)), anchored(*prog, false), backward(*reversed, true)
+{}
+
+pattern::pattern(const pattern &other)
+  : prog(other.prog), reversed(other.reversed), anchored(*prog, false), backward(*reversed, true)
+{}
+
+const std::string &pattern::required() const { return prog->literal; }
+
+void pattern::find(std::string_view text, std::vector<std::pair<std::size_t, std::size_t>> &out)
+{
+  auto n = text.size();
+  auto byte = [&](std::size_t i) { return static_cast<unsigned char>(text[i]); };
+
+  // Read backwards from the end of the row, the reversed pattern accepts
+  // wherever a match starts; at the start of the row that may take a '^'
+  starts.clear();
+  auto r = backward.start(true);
+  for (auto i = n; i-- > 0;) {
+    r = backward.next(r, byte(i));
+    if (i > 0 ? backward.accepts(r) : backward.acceptsAtEnd(r)) starts.push_back(i);
+  }
+
+  // The longest match from the leftmost start, then the same after its end.
+  // A start may only have an empty match, which is skipped.
+  std::size_t pos = 0;
+  for (auto it = starts.rbegin(); it != starts.rend(); ++it) {
+    auto from = *it;
+    if (from < pos) continue;
+    auto a = anchored.start(from == 0);
+    std::size_t length = 0;
+    auto i = from;
+    for (; i < n && a != dfa::DEAD; i++) {
+      a = anchored.next(a, byte(i));
+      if (anchored.accepts(a)) length = i + 1 - from;
+    }
+    if (i == n && anchored.acceptsAtEnd(a)) length = n - from;
+    if (length > 0) {
+      out.emplace_back(from, length);
+      pos = from + length;
+    }
+  }
+}
+
+/*** lazy DFA ***/
+
+pattern::dfa::dfa(const program &p, bool anywhere)
+  : prog(p), floating(anywhere), cls(p.cls), classes(p.classes), mark(p.code.size())
+{
+  flush();
+}
+
+void pattern::dfa::flush()
+{
+  ids.clear();
+  sets.clear();
+  info.clear();
+  table.clear();
+  starts = { UNKNOWN, UNKNOWN };
+  flushes++;
+  intern({});
+}
+
+std::int32_t pattern::dfa::start(bool at_line_start)
+{
+  auto &id = starts[at_line_start];
+  if (id == UNKNOWN) {
+    scratch.clear();
+    closure(prog, 0, at_line_start, false, scratch, mark, ++generation, stack);
+    std::sort(scratch.begin(), scratch.end());
+    id = intern(std::vector<std::int32_t>(scratch));
+  }
+  return id;
+}
+
+std::int32_t pattern::dfa::step(std::int32_t s, unsigned char c)
+{
+  scratch.clear();
+  ++generation;
+  for (auto pc : *sets[static_cast<std::size_t>(s)]) {
+    const auto &in = prog.code[static_cast<std::size_t>(pc)];
+    if (in.code == program::SET && prog.sets[static_cast<std::size_t>(in.x)][c]) {
+      closure(prog, pc + 1, false, false, scratch, mark, generation, stack);
+    }
+  }
+  if (floating) closure(prog, 0, false, false, scratch, mark, generation, stack);
+  std::sort(scratch.begin(), scratch.end());
+
+  auto before = flushes;
+  auto t = intern(std::vector<std::int32_t>(scratch));
+  // After a flush s is gone, and so is its row of the table
+  if (flushes == before) table[static_cast<std::size_t>(s) * classes + cls[c]] = t;
+  return t;
+}
+
+std::int32_t pattern::dfa::intern(std::vector<std::int32_t> &&set)
+{
+  if (auto it = ids.find(set); it != ids.end()) return it->second;
+  if (info.size() >= PATTERN_MAX_STATES) flush();
+
+  auto id = static_cast<std::int32_t>(info.size());
+  auto it = ids.emplace(std::move(set), id).first;
+  sets.push_back(&it->first);
+
+  state st{ false, false };
+  std::vector<std::int32_t> atEnd;
+  auto gen = ++generation;
+  for (auto pc : it->first) {
+    auto code = prog.code[static_cast<std::size_t>(pc)].code;
+    if (code == program::MATCH) st.accept = true;
+    if (code == program::EOL) closure(prog, pc + 1, false, true, atEnd, mark, gen, stack);
+  }
+  st.accept_at_end =
+    st.accept || std::any_of(atEnd.begin(), atEnd.end(), [&](auto pc) { return prog.code[static_cast<std::size_t>(pc)].code == program::MATCH; });
+  info.push_back(st);
+  table.resize(table.size() + classes, UNKNOWN);
+  return id;
+}
+
+
+}// end namespace search
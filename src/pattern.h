@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace search {
+
+// A regular expression, compiled to a program for an NFA and matched by
+// running that as a DFA whose states are built lazily, as the text being
+// matched needs them. There is no backtracking: once its states are built,
+// the DFA takes a table lookup per byte, and no pattern makes it blow up.
+//
+// Where matches can start is found in one pass over a row, backwards, with
+// the pattern reversed; from each start the longest match is then found
+// going forwards. A row costs time linear in its length, plus how far past
+// the end of each match the pattern could still have gone on.
+//
+// Supported are literals, '.', classes like [a-z] and [^"], the escapes \d
+// \w \s \D \W \S \t and \ before any punctuation, groups, '|', '*', '+',
+// '?', {m}, {m,} and {m,n}, and '^' and '$' at the start and end of a row.
+// Matching is byte by byte.
+//
+// Copies share the program but build states of their own, so that every
+// thread can match with its own copy.
+class pattern
+{
+public:
+  // Throws std::runtime_error if the expression is not valid
+  explicit pattern(std::string_view expression);
+
+  pattern(const pattern &other);
+  pattern &operator=(const pattern &) = delete;
+
+  // Appends the start and length of every match in text to 'out': the
+  // leftmost-longest one, then the same after its end, and so on. Empty
+  // matches are left out. Only allocates while states are being built.
+  void find(std::string_view text, std::vector<std::pair<std::size_t, std::size_t>> &out);
+
+  // A string every match contains, or empty if there is none. Rows without
+  // it can be skipped with a substring scan before running the DFA.
+  const std::string &required() const;
+
+  // Number of DFA states built so far, for tests and benchmarks
+  std::size_t states() const { return anchored.size() + backward.size(); }
+
+  struct program;
+
+private:
+  explicit pattern(std::pair<std::shared_ptr<const program>, std::shared_ptr<const program>> programs);
+
+  // A DFA whose states are sets of program positions. Its transitions are
+  // filled in as they are first taken; once it has too many states, it is
+  // thrown away and built up again.
+  class dfa
+  {
+  public:
+    dfa(const program &p, bool anywhere);
+
+    // State ids; DEAD is the state without positions
+    static constexpr std::int32_t DEAD{ 0 };
+    static constexpr std::int32_t UNKNOWN{ -1 };
+
+    std::int32_t start(bool at_line_start);
+    std::int32_t next(std::int32_t s, unsigned char c)
+    {
+      auto t = table[static_cast<std::size_t>(s) * classes + cls[c]];
+      return t != UNKNOWN ? t : step(s, c);
+    }
+    bool accepts(std::int32_t s) const { return info[static_cast<std::size_t>(s)].accept; }
+    bool acceptsAtEnd(std::int32_t s) const { return info[static_cast<std::size_t>(s)].accept_at_end; }
+    std::size_t size() const { return info.size(); }
+
+  private:
+    struct state
+    {
+      bool accept;
+      bool accept_at_end;
+    };
+
+    std::int32_t step(std::int32_t s, unsigned char c);
+    std::int32_t intern(std::vector<std::int32_t> &&set);
+    void flush();
+
+    const program &prog;
+    bool floating;// matches may start at any position
+    const std::array<std::uint8_t, 256> &cls;
+    std::size_t classes;
+
+    std::map<std::vector<std::int32_t>, std::int32_t> ids{};
+    std::vector<const std::vector<std::int32_t> *> sets{};
+    std::vector<state> info{};
+    std::vector<std::int32_t> table{};
+    std::array<std::int32_t, 2> starts{ UNKNOWN, UNKNOWN };
+    std::size_t flushes{};
+
+    // For building sets of positions
+    std::vector<std::int32_t> scratch{};
+    std::vector<std::int32_t> stack{};
+    std::vector<std::uint32_t> mark;
+    std::uint32_t generation{};
+  };
+
+  std::shared_ptr<const program> prog;
+  std::shared_ptr<const program> reversed;
+  dfa anchored;
+  dfa backward;// the reversed pattern, matches starting anywhere
+  std::vector<std::size_t> starts{};// where matches start, last first
+};
+
+}// end namespace search
@@ -0,0 +1,56 @@
+#include "pool.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace pool {
+
+threadPool::threadPool(std::size_t threads)
+{
+  for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); i++) workers.emplace_back(&threadPool::work, this);
+}
+
+threadPool::~threadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  for (auto &w : workers) w.join();
+}
+
+std::future<void> threadPool::submit(std::function<void()> task)
+{
+  std::packaged_task<void()> pt(std::move(task));
+  auto f = pt.get_future();
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    tasks.push(std::move(pt));
+  }
+  cv.notify_one();
+  return f;
+}
+
+void threadPool::work()
+{
+  while (true) {
+    std::packaged_task<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      cv.wait(lock, [&] { return stopping || !tasks.empty(); });
+      if (tasks.empty()) return;
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+    task();
+  }
+}
+
+threadPool &Shared()
+{
+  static threadPool shared(std::thread::hardware_concurrency());
+  return shared;
+}
+
+}// end namespace pool
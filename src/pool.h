@@ -0,0 +1,40 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+namespace pool {
+
+// A fixed set of worker threads running queued tasks in FIFO order
+class threadPool
+{
+public:
+  explicit threadPool(std::size_t threads);
+  ~threadPool();
+
+  threadPool(const threadPool &) = delete;
+  threadPool &operator=(const threadPool &) = delete;
+
+  std::size_t size() const { return workers.size(); }
+  std::future<void> submit(std::function<void()> task);
+
+private:
+  void work();
+
+  std::vector<std::thread> workers{};
+  std::queue<std::packaged_task<void()>> tasks{};
+  std::mutex mutex{};
+  std::condition_variable cv{};
+  bool stopping{ false };
+};
+
+// The pool shared by the editor, with one thread per hardware thread
+threadPool &Shared();
+
+}// end namespace pool
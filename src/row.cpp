@@ -1,19 +1,57 @@
 #include "row.h"
 
+#include <algorithm>
+#include <memory>
 #include <string>
+#include <string_view>
 
 const std::size_t KILO_TAB_STOP{ 8 };
+// Rows shorter than this are scanned to convert columns; longer ones get an
+// index of their tabs so that moving along them doesn't rescan the row
+const std::size_t KILO_TAB_INDEX_MIN{ 256 };
 
 
 namespace row {
 
+using edit::rowString;
+
 /*** row operations ***/
 
+namespace {
+
+  const std::vector<edit::tabStop> &Tabs(const edit::erow &r)
+  {
+    if (!r.tabs) {
+      r.tabs = std::make_unique<std::vector<edit::tabStop>>();
+      std::size_t rx = 0;
+      std::size_t from = 0;
+      for (auto j = r.chars.find('\t'); j < r.size; j = r.chars.find('\t', j + 1)) {
+        rx += j - from;
+        rx += KILO_TAB_STOP - (rx % KILO_TAB_STOP);
+        r.tabs->push_back(edit::tabStop{ j, rx });
+        from = j + 1;
+      }
+    }
+    return *r.tabs;
+  }
+
+}// namespace
+
 std::size_t CxToRx(const edit::erow &r, const std::size_t cx)
 {
+  if (r.size >= KILO_TAB_INDEX_MIN) {
+    // Columns advance one by one from the last tab before cx
+    const auto &tabs = Tabs(r);
+    auto it = std::lower_bound(
+      tabs.begin(), tabs.end(), cx, [](const edit::tabStop &t, std::size_t c) { return t.cx < c; });
+    if (it == tabs.begin()) return cx;
+    --it;
+    return it->rx + (cx - it->cx - 1);
+  }
+
   std::size_t rx = 0;
   for (std::size_t j = 0; j < cx; j++) {
-    if (r.chars.at(j) == '\t') rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
+    if (r.chars[j] == '\t') rx += (KILO_TAB_STOP - 1) - (rx % KILO_TAB_STOP);
     rx++;
   }
   return rx;
@@ -21,10 +59,20 @@ std::size_t CxToRx(const edit::erow &r, const std::size_t cx)
 
 std::size_t RxToCx(const edit::erow &r, const std::size_t rx)
 {
+  if (r.size >= KILO_TAB_INDEX_MIN) {
+    // The character covering rx follows the last tab ending at or before it,
+    // unless the next tab gets there first
+    const auto &tabs = Tabs(r);
+    auto next = std::upper_bound(
+      tabs.begin(), tabs.end(), rx, [](std::size_t c, const edit::tabStop &t) { return c < t.rx; });
+    auto cx = (next == tabs.begin()) ? rx : std::prev(next)->cx + 1 + (rx - std::prev(next)->rx);
+    return std::min(cx, next == tabs.end() ? r.size : next->cx);
+  }
+
   std::size_t cur_rx = 0;
   std::size_t cx = 0;
   for (cx = 0; cx < r.size; cx++) {
-    if (r.chars.at(cx) == '\t') cur_rx += (KILO_TAB_STOP - 1) - (cur_rx % KILO_TAB_STOP);
+    if (r.chars[cx] == '\t') cur_rx += (KILO_TAB_STOP - 1) - (cur_rx % KILO_TAB_STOP);
     cur_rx++;
 
     if (cur_rx > rx) return cx;
@@ -32,24 +80,71 @@ std::size_t RxToCx(const edit::erow &r, const std::size_t rx)
   return cx;
 }
 
-void Update(edit::erow &r)
-{
-  r.render.erase();
-  std::size_t idx = 0;// FIXME: Try to get rid of idx
-  for (std::size_t j = 0; j < r.size; j++) {
-    if (r.chars.at(j) == '\t') {
-      r.render.insert(idx, 1, ' ');
-      idx++;
-      while (idx % KILO_TAB_STOP != 0) {
-        r.render.insert(idx, 1, ' ');
-        idx++;
+namespace {
+
+  // Renders chars[from, size) after the first rx render columns, which are
+  // kept. The length is worked out first so the render is sized once, then
+  // the runs between tabs are copied whole. Rows without tabs keep no copy.
+  void render(edit::erow &r, std::size_t from, std::size_t rx)
+  {
+    if (r.chars.find('\t', from) >= r.size) {
+      // Without any tab the row is drawn straight from chars
+      if (r.expanded.empty() || r.chars.find('\t') >= from) {
+        rowString().swap(r.expanded);
+        r.rsize = r.size;
+        return;
       }
-    } else {
-      r.render.insert(idx, 1, r.chars.at(j));
-      idx++;
+    } else if (r.expanded.empty()) {
+      // The first tab: until here the row was drawn from chars, so rx == from
+      r.expanded.assign(r.chars, 0, from);
+    }
+
+    std::size_t len = rx;
+    std::size_t j = from;
+    for (auto t = r.chars.find('\t', from); t < r.size; t = r.chars.find('\t', t + 1)) {
+      len += t - j;
+      len += KILO_TAB_STOP - (len % KILO_TAB_STOP);
+      j = t + 1;
     }
+    len += r.size - j;
+    r.expanded.resize(len);
+
+    const char *in = r.chars.data();
+    char *out = r.expanded.data();
+    std::size_t at = rx;
+    j = from;
+    for (auto t = r.chars.find('\t', from); t < r.size; t = r.chars.find('\t', t + 1)) {
+      std::copy(in + j, in + t, out + at);
+      at += t - j;
+      auto pad = KILO_TAB_STOP - (at % KILO_TAB_STOP);
+      std::fill(out + at, out + at + pad, ' ');
+      at += pad;
+      if (r.tabs) r.tabs->push_back(edit::tabStop{ t, at });
+      j = t + 1;
+    }
+    std::copy(in + j, in + r.size, out + at);
+    r.rsize = len;
+  }
+
+}// namespace
+
+void Update(edit::erow &r)
+{
+  r.tabs.reset();
+  render(r, 0, 0);
+}
+
+void Update(edit::erow &r, std::size_t from)
+{
+  from = std::min(from, r.size);
+  auto rx = CxToRx(r, from);
+  // Tabs before the edit keep their place; the ones after are found again
+  if (r.tabs) {
+    auto keep = std::lower_bound(
+      r.tabs->begin(), r.tabs->end(), from, [](const edit::tabStop &t, std::size_t c) { return t.cx < c; });
+    r.tabs->erase(keep, r.tabs->end());
   }
-  r.rsize = r.render.length();
+  render(r, from, rx);
 }
 
 void InsertChar(edit::erow &r, const int at, const char c)
@@ -58,22 +153,23 @@ void InsertChar(edit::erow &r, const int at, const char c)
   if (at < 0 || static_cast<std::size_t>(at) > r.size) idx = r.size;
   r.chars.insert(idx, 1, c);
   r.size++;
-  Update(r);
+  Update(r, idx);
 }
 
-void AppendString(edit::erow &r, const std::string &s)
+void AppendString(edit::erow &r, std::string_view s)
 {
+  auto from = r.size;
   r.chars.append(s);
   r.size += s.length();
-  Update(r);
+  Update(r, from);
 }
 
 void DelChar(edit::erow &r, const int at)
 {
   if (at < 0 || at >= static_cast<int>(r.size)) return;
-  r.chars.erase(at, 1);
+  r.chars.erase(static_cast<std::size_t>(at), 1);
   r.size--;
-  Update(r);
+  Update(r, static_cast<std::size_t>(at));
 }
 
 }// end namespace row
@@ -2,14 +2,17 @@
 
 #include "edit.h"
 #include <string>
+#include <string_view>
 
 namespace row {
 
 std::size_t CxToRx(const edit::erow &, const std::size_t);
 std::size_t RxToCx(const edit::erow &, const std::size_t);
 void Update(edit::erow &);
+// Re-renders a row that only changed from chars[from] on
+void Update(edit::erow &, std::size_t from);
 void InsertChar(edit::erow &, const int, const char);
-void AppendString(edit::erow &, const std::string &);
+void AppendString(edit::erow &, std::string_view);
 void DelChar(edit::erow &, const int);
 
 }// end namespace row
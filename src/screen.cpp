@@ -0,0 +1,180 @@
+#include "screen.h"
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+
+using Term::fg;
+
+namespace screen {
+
+// Runs of unchanged cells up to this long are rewritten rather than skipped
+// over with a cursor motion, which would take about as many bytes
+const std::size_t MAX_REWRITE{ 4 };
+
+unsigned char Attr(fg color, bool reversed)
+{
+  unsigned char a = (color == fg::reset) ? 0 : static_cast<unsigned char>(static_cast<int>(color) - 29);
+  return reversed ? (a | 0x10) : a;
+}
+
+/*** drawing ***/
+
+void frame::resize(std::size_t rows, std::size_t cols)
+{
+  nrows = rows;
+  ncols = cols;
+  cells.assign(rows * cols, cell{});
+}
+
+void frame::clear() { std::fill(cells.begin(), cells.end(), cell{}); }
+
+void frame::set(std::size_t y, std::size_t x, char c, unsigned char attr)
+{
+  if (y < nrows && x < ncols) cells[y * ncols + x] = cell{ c, attr };
+}
+
+std::size_t frame::print(std::size_t y, std::size_t x, const char *s, std::size_t len, unsigned char attr)
+{
+  if (y >= nrows || x >= ncols) return x + len;
+  auto *c = &cells[y * ncols + x];
+  auto n = std::min(len, ncols - x);
+  for (std::size_t i = 0; i < n; i++) c[i] = cell{ s[i], attr };
+  return x + len;
+}
+
+/*** output ***/
+
+namespace {
+
+  // The escape sequence selecting each attribute value, built at compile time
+  // so that changing colors doesn't format a string every time
+  struct sgrTable
+  {
+    std::array<std::array<char, 12>, 32> seq{};
+    std::array<std::size_t, 32> len{};
+
+    constexpr sgrTable()
+    {
+      for (std::size_t a = 0; a < seq.size(); a++) {
+        auto &s = seq[a];
+        std::size_t n = 0;
+        for (char c : { '\x1b', '[', '0' }) s[n++] = c;
+        if ((a & 0x0f) != 0) {
+          s[n++] = ';';
+          s[n++] = '3';
+          s[n++] = static_cast<char>('0' + (a & 0x0f) - 1);
+        }
+        if (a & 0x10) {
+          s[n++] = ';';
+          s[n++] = '7';
+        }
+        s[n++] = 'm';
+        len[a] = n;
+      }
+    }
+  };
+  constexpr sgrTable SGR{};
+
+  void appendAttr(std::string &ab, unsigned char attr) { ab.append(SGR.seq[attr & 0x1f].data(), SGR.len[attr & 0x1f]); }
+
+  void appendNumber(std::string &ab, std::size_t n)
+  {
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), n);
+    ab.append(buf, static_cast<std::size_t>(res.ptr - buf));
+  }
+
+  void appendRight(std::string &ab, std::size_t n)
+  {
+    ab.append("\x1b[");
+    appendNumber(ab, n);
+    ab.push_back('C');
+  }
+
+  bool isAscii(const cell *l, std::size_t n)
+  {
+    return std::all_of(l, l + n, [](const cell &c) { return static_cast<unsigned char>(c.ch) < 0x80; });
+  }
+
+}// namespace
+
+void MoveCursor(std::string &ab, std::size_t y, std::size_t x)
+{
+  ab.append("\x1b[");
+  appendNumber(ab, y + 1);
+  ab.push_back(';');
+  appendNumber(ab, x + 1);
+  ab.push_back('H');
+}
+
+void frame::diff(const frame &shown, std::string &ab) const
+{
+  unsigned char cur = 0;
+  std::size_t cy = nrows, cx = 0;// where the cursor is, if known
+
+  auto moveTo = [&](std::size_t y, std::size_t x) {
+    if (y == cy && x > cx) {
+      appendRight(ab, x - cx);
+    } else if (y != cy || x != cx) {
+      MoveCursor(ab, y, x);
+    }
+    cy = y;
+    cx = x;
+  };
+
+  // Without a frame of the same size to compare with, the terminal is
+  // assumed to have been cleared
+  static const cell blank_cell{};
+  bool comparable = (shown.nrows == nrows && shown.ncols == ncols);
+
+  for (std::size_t y = 0; y < nrows; y++) {
+    const cell *now = line(y);
+    const cell *was = comparable ? shown.line(y) : nullptr;
+    auto prev = [&](std::size_t x) -> const cell & { return was ? was[x] : blank_cell; };
+
+    std::size_t first = 0;
+    while (first < ncols && now[first] == prev(first)) first++;
+    if (first == ncols) continue;
+    std::size_t last = ncols;
+    while (last > first && now[last - 1] == prev(last - 1)) last--;
+
+    // Multi-byte characters take fewer columns than bytes, so column
+    // positions can't be trusted on such lines: redraw them whole.
+    bool whole = !isAscii(now, ncols) || (was && !isAscii(was, ncols));
+    if (whole) {
+      first = 0;
+      last = ncols;
+    }
+
+    std::size_t blank = ncols;
+    while (blank > first && now[blank - 1] == blank_cell) blank--;
+
+    moveTo(y, first);
+    for (auto x = first; x < last;) {
+      if (x >= blank) {
+        if (cur != 0) appendAttr(ab, cur = 0);
+        ab.append("\x1b[K");
+        break;
+      }
+      if (!whole && now[x] == prev(x)) {
+        auto same = x;
+        while (same < last && now[same] == prev(same)) same++;
+        if (same - x > MAX_REWRITE) {
+          moveTo(y, same);
+          x = same;
+          continue;
+        }
+      }
+      if (now[x].attr != cur) appendAttr(ab, cur = now[x].attr);
+      ab.push_back(now[x].ch);
+      cx = ++x;
+      // After the last column the cursor waits to wrap; don't rely on it
+      if (x == ncols) cy = nrows;
+    }
+    if (whole) cy = nrows;
+  }
+  if (cur != 0) appendAttr(ab, 0);
+}
+
+}// end namespace screen
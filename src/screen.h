@@ -0,0 +1,55 @@
+#pragma once
+
+#include "terminal.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace screen {
+
+// Packs a foreground color and the reversed style into one byte, 0 being the
+// terminal's default look
+unsigned char Attr(Term::fg color, bool reversed = false);
+
+// Appends the sequence moving the cursor to 0-based row y, column x
+void MoveCursor(std::string &ab, std::size_t y, std::size_t x);
+
+struct cell
+{
+  char ch{ ' ' };
+  unsigned char attr{};
+
+  bool operator==(const cell &) const = default;
+};
+
+// The content of the whole terminal as a grid of cells. A new frame is drawn
+// for every refresh and compared to the one on screen, so that only the
+// cells that changed are sent to the terminal.
+class frame
+{
+public:
+  void resize(std::size_t rows, std::size_t cols);
+  std::size_t rows() const { return nrows; }
+  std::size_t cols() const { return ncols; }
+  // Blanks every cell
+  void clear();
+
+  // Positions are 0-based; anything past the right edge is dropped
+  void set(std::size_t y, std::size_t x, char c, unsigned char attr = 0);
+  // Returns the column after the last character written
+  std::size_t print(std::size_t y, std::size_t x, const char *s, std::size_t len, unsigned char attr = 0);
+
+  // Appends to ab what has to be written to turn 'shown' on the terminal into
+  // this frame. The cursor is left in an unspecified place.
+  void diff(const frame &shown, std::string &ab) const;
+
+private:
+  const cell *line(std::size_t y) const { return &cells[y * ncols]; }
+
+  std::size_t nrows{};
+  std::size_t ncols{};
+  std::vector<cell> cells{};
+};
+
+}// end namespace screen
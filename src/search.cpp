@@ -0,0 +1,415 @@
+#include "search.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <stdexcept>
+#include <utility>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define KILO_X86 1
+#endif
+
+namespace search {
+
+/*** substring scanning ***/
+
+namespace {
+
+  // Whether the needle matches at p, given that its first and last byte do
+  inline bool middleMatches(const char *p, std::string_view needle)
+  {
+    return needle.size() <= 2 || memcmp(p + 1, needle.data() + 1, needle.size() - 2) == 0;
+  }
+
+  void scanScalar(const char *data, std::size_t len, std::size_t base, std::string_view needle, std::vector<std::size_t> &out)
+  {
+    auto n = needle.size();
+    if (len < n) return;
+    const char *end = data + len - n + 1;
+    for (auto *p = data; p < end; p++) {
+      p = static_cast<const char *>(memchr(p, needle[0], static_cast<std::size_t>(end - p)));
+      if (!p) break;
+      if (p[n - 1] == needle[n - 1] && middleMatches(p, needle)) out.push_back(base + static_cast<std::size_t>(p - data));
+    }
+  }
+
+#ifdef KILO_X86
+  __attribute__((target("sse2"))) void
+    scanSse2(const char *data, std::size_t len, std::string_view needle, std::vector<std::size_t> &out)
+  {
+    auto n = needle.size();
+    const __m128i first = _mm_set1_epi8(needle[0]);
+    const __m128i last = _mm_set1_epi8(needle[n - 1]);
+    std::size_t i = 0;
+    for (; i + n - 1 + 16 <= len; i += 16) {
+      auto a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+      auto b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i + n - 1));
+      auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, first), _mm_cmpeq_epi8(b, last))));
+      while (mask) {
+        auto at = i + static_cast<std::size_t>(__builtin_ctz(mask));
+        if (middleMatches(data + at, needle)) out.push_back(at);
+        mask &= mask - 1;
+      }
+    }
+    scanScalar(data + i, len - i, i, needle, out);
+  }
+
+  __attribute__((target("avx2"))) void
+    scanAvx2(const char *data, std::size_t len, std::string_view needle, std::vector<std::size_t> &out)
+  {
+    auto n = needle.size();
+    const __m256i first = _mm256_set1_epi8(needle[0]);
+    const __m256i last = _mm256_set1_epi8(needle[n - 1]);
+    std::size_t i = 0;
+    for (; i + n - 1 + 32 <= len; i += 32) {
+      auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+      auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + n - 1));
+      auto mask =
+        static_cast<unsigned>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, first), _mm256_cmpeq_epi8(b, last))));
+      while (mask) {
+        auto at = i + static_cast<std::size_t>(__builtin_ctz(mask));
+        if (middleMatches(data + at, needle)) out.push_back(at);
+        mask &= mask - 1;
+      }
+    }
+    scanScalar(data + i, len - i, i, needle, out);
+  }
+#endif
+
+}// namespace
+
+void Scan(std::string_view text, std::string_view needle, std::vector<std::size_t> &out, edit::scanner s)
+{
+  static const auto best = edit::ScannerSupported(edit::scanner::avx2)   ? edit::scanner::avx2
+                           : edit::ScannerSupported(edit::scanner::sse2) ? edit::scanner::sse2
+                                                                         : edit::scanner::scalar;
+  if (needle.empty() || text.size() < needle.size()) return;
+  if (s == edit::scanner::automatic || !edit::ScannerSupported(s)) s = best;
+
+  switch (s) {
+#ifdef KILO_X86
+  case edit::scanner::avx2:
+    scanAvx2(text.data(), text.size(), needle, out);
+    break;
+  case edit::scanner::sse2:
+    scanSse2(text.data(), text.size(), needle, out);
+    break;
+#endif
+  default:
+    scanScalar(text.data(), text.size(), 0, needle, out);
+    break;
+  }
+}
+
+/*** match index ***/
+
+// A parallel search gives each slice at least this many rows
+const std::size_t SEARCH_SLICE_MIN_ROWS{ 16384 };
+
+namespace {
+
+  // Drops the pages of a run of mapped rows once it has been scanned, as
+  // edit::mappedFile does while indexing, so that a search doesn't leave the
+  // whole file charged to our RSS
+  void release(std::string_view text)
+  {
+    static const auto page = static_cast<std::uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto from = reinterpret_cast<std::uintptr_t>(text.data()) / page * page;
+    auto to = (reinterpret_cast<std::uintptr_t>(text.data() + text.size()) + page - 1) / page * page;
+    madvise(reinterpret_cast<void *>(from), to - from, MADV_DONTNEED);
+  }
+
+  // What a slice of a search found
+  struct slice
+  {
+    std::vector<match> found{};
+    std::vector<tail> rest{};
+    bool truncated{ false };
+    std::size_t resume{};
+  };
+
+  // Searches rows [from, to) into s, until 'cancelled' is set or s has found
+  // 'limit' matches. Rows of a mapped file that have not been
+  // read are searched as one piece of mapped text; the newlines before a
+  // match give its row. With a pattern, only the rows that contain its
+  // required literal, if it has one, are run through its DFA.
+  void scanRows(const edit::rowSnapshot &rows,
+    std::string_view query,
+    pattern *re,
+    std::size_t from,
+    std::size_t to,
+    slice &s,
+    std::size_t limit,
+    const std::atomic<bool> &cancelled)
+  {
+    std::string_view literal = re ? std::string_view(re->required()) : query;
+    std::vector<std::size_t> hits;
+    std::vector<std::pair<std::size_t, std::size_t>> spans;
+    bool stopped = false;
+
+    // Adds a match at 'at' in the text of a run, 'col' into its row
+    auto add = [&](std::string_view text, std::size_t row, std::size_t at, std::size_t col, std::size_t length) {
+      if (row >= to) {
+        stopped = true;
+        return;
+      }
+      if (s.found.size() >= limit) {
+        // Keep only whole rows, so that the search can go on from this one
+        while (!s.found.empty() && s.found.back().row == row) {
+          s.found.pop_back();
+          if (!re) s.rest.pop_back();
+        }
+        s.truncated = stopped = true;
+        s.resume = row;
+        return;
+      }
+      s.found.push_back(match{ row, col, length });
+      if (re) return;
+      tail t{ text.substr(at), {}, 0 };
+      t.length = static_cast<unsigned char>(std::min(t.rest.size(), sizeof(t.head)));
+      memcpy(t.head, t.rest.data(), t.length);
+      s.rest.push_back(t);
+    };
+
+    // Runs the pattern over the row starting at 'start' in the text of a run
+    auto matchRow = [&](std::string_view text, std::size_t row, std::size_t start) {
+      auto end = text.find('\n', start);
+      if (end == std::string_view::npos) end = text.size();
+      auto line = text.substr(start, end - start);
+      if (end < text.size() && line.ends_with('\r')) line.remove_suffix(1);
+      spans.clear();
+      re->find(line, spans);
+      for (auto [col, length] : spans) {
+        add(text, row, start + col, col, length);
+        if (stopped) break;
+      }
+      return end;
+    };
+
+    rows.forEachRun(
+      [&](std::size_t row, std::string_view text, std::size_t lines) {
+        if (stopped || (stopped = cancelled.load(std::memory_order_relaxed))) return;
+        for (; row < from; row++, lines--) {
+          text.remove_prefix(static_cast<std::size_t>(static_cast<const char *>(memchr(text.data(), '\n', text.size())) - text.data()) + 1);
+        }
+
+        bool mapped = lines > 1;
+        if (literal.empty()) {
+          // Nothing to scan for: every row goes through the DFA
+          for (std::size_t start = 0; !stopped && row < to && start <= text.size(); row++) {
+            start = matchRow(text, row, start) + 1;
+            if (--lines == 0) break;
+          }
+          if (mapped) release(text);
+          return;
+        }
+
+        hits.clear();
+        Scan(text, literal, hits);
+        std::size_t start = 0;
+        auto last = std::string_view::npos;// row last run through the pattern
+        for (auto at : hits) {
+          while (lines > 1) {
+            auto *nl = static_cast<const char *>(memchr(text.data() + start, '\n', at - start));
+            if (!nl) break;
+            start = static_cast<std::size_t>(nl - text.data()) + 1;
+            row++;
+          }
+          if (!re) {
+            add(text, row, at, at - start, query.size());
+          } else if (row != last) {
+            last = row;
+            if (row >= to) {
+              stopped = true;
+            } else {
+              matchRow(text, row, start);
+            }
+          }
+          if (stopped) break;
+        }
+        if (mapped) release(text);
+      },
+      from,
+      to);
+  }
+
+}// namespace
+
+struct matchIndex::scanJob
+{
+  std::string query;
+  pattern *re;// the compiled query, or null
+  std::atomic<bool> cancelled{ false };
+  std::vector<slice> slices{};
+  std::vector<std::future<void>> done{};
+  std::size_t collected{};// slices moved into the index so far
+};
+
+matchIndex::matchIndex() = default;
+
+matchIndex::~matchIndex() { cancel(); }
+
+void matchIndex::update(const edit::rowBuffer &rows, std::string_view q, bool r)
+{
+  bool grown = !r && !regex && !query.empty() && !job && q.size() > query.size() && q.starts_with(query);
+  cancel();
+  if (r && (!compiled || !regex || q != query)) {
+    compiled.reset();
+    invalid.clear();
+    try {
+      compiled = std::make_unique<pattern>(q);
+    } catch (const std::runtime_error &e) {
+      invalid = e.what();
+    }
+  }
+  if (!r) invalid.clear();
+  query = q;
+  regex = r;
+  if (query.empty() || !invalid.empty()) {
+    found.clear();
+    rest.clear();
+    truncated = false;
+    held = edit::rowSnapshot();
+  } else if (grown) {
+    narrow();
+    // Rows past the ones that had too many matches still have to be searched
+    if (truncated) start(resume);
+  } else {
+    found.clear();
+    rest.clear();
+    held = rows.snapshot();
+    start(0);
+  }
+}
+
+void matchIndex::clear()
+{
+  cancel();
+  query.clear();
+  invalid.clear();
+  found.clear();
+  rest.clear();
+  truncated = false;
+  held = edit::rowSnapshot();
+}
+
+std::vector<match> matchIndex::release()
+{
+  auto out = std::move(found);
+  clear();
+  return out;
+}
+
+void matchIndex::start(std::size_t from)
+{
+  truncated = false;
+  auto end = held.size();
+  if (from >= end) return;
+
+  auto &workers = pool::Shared();
+  auto n = std::min(workers.size() * 4, (end - from) / SEARCH_SLICE_MIN_ROWS);
+  // Every slice may find all the matches there is room for, so that what is
+  // kept is the first of them whatever order the slices end in
+  auto limit = KILO_SEARCH_MAX_MATCHES - found.size();
+  job = std::make_unique<scanJob>();
+  job->query = query;
+  job->re = regex ? compiled.get() : nullptr;
+  job->slices.resize(std::max<std::size_t>(n, 1));
+  if (n < 2) {
+    // Not worth handing to other threads
+    scanRows(held, job->query, job->re, from, end, job->slices[0], limit, job->cancelled);
+    std::promise<void> p;
+    p.set_value();
+    job->done.push_back(p.get_future());
+    poll();
+    return;
+  }
+
+  for (std::size_t c = 0; c < n; c++) {
+    auto first = from + (end - from) * c / n;
+    auto last = from + (end - from) * (c + 1) / n;
+    job->done.push_back(workers.submit([this, j = job.get(), c, first, last, limit] {
+      // Every thread builds DFA states of its own
+      std::unique_ptr<pattern> re;
+      if (j->re) re = std::make_unique<pattern>(*j->re);
+      scanRows(held, j->query, re.get(), first, last, j->slices[c], limit, j->cancelled);
+    }));
+  }
+}
+
+bool matchIndex::poll()
+{
+  if (!job) return true;
+  auto &j = *job;
+  while (j.collected < j.slices.size() && j.done[j.collected].wait_for(std::chrono::seconds(0)) == std::future_status::ready) {
+    j.done[j.collected].get();
+    auto &s = j.slices[j.collected++];
+    auto room = KILO_SEARCH_MAX_MATCHES - found.size();
+    if (s.found.size() > room) {
+      // Keep only whole rows, so that the search can go on from the first
+      // row left out
+      auto row = s.found[room].row;
+      while (room > 0 && s.found[room - 1].row == row) room--;
+      s.found.resize(room);
+      if (!s.rest.empty()) s.rest.resize(room);
+      s.truncated = true;
+      s.resume = row;
+    }
+    found.insert(found.end(), s.found.begin(), s.found.end());
+    rest.insert(rest.end(), s.rest.begin(), s.rest.end());
+    if (s.truncated) {
+      // Later slices start past the point where the matches stop
+      truncated = true;
+      resume = s.resume;
+      break;
+    }
+  }
+  if (j.collected < j.slices.size() && !truncated) return false;
+  cancel();
+  return true;
+}
+
+bool matchIndex::wait(std::chrono::milliseconds timeout)
+{
+  auto deadline = std::chrono::steady_clock::now() + timeout;
+  while (!poll()) {
+    if (job->done[job->collected].wait_until(deadline) == std::future_status::timeout) return poll();
+  }
+  return true;
+}
+
+void matchIndex::cancel()
+{
+  if (!job) return;
+  job->cancelled = true;
+  for (auto &f : job->done) {
+    if (f.valid()) f.wait();
+  }
+  job.reset();
+}
+
+// Every match of the longer query starts where one of the shorter query did
+void matchIndex::narrow()
+{
+  std::size_t keep = 0;
+  for (std::size_t i = 0; i < found.size(); i++) {
+    const auto &t = rest[i];
+    if (query.size() <= t.length ? memcmp(t.head, query.data(), query.size()) == 0 : t.rest.starts_with(query)) {
+      found[keep] = found[i];
+      found[keep].length = query.size();
+      rest[keep++] = rest[i];
+    }
+  }
+  found.resize(keep);
+  rest.resize(keep);
+}
+
+}// end namespace search
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "buffer.h"
+#include "lineindex.h"
+#include "pattern.h"
+
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace search {
+
+// The most matches a matchIndex keeps; a query matching more often than this
+// is only searched for up to that point
+const std::size_t KILO_SEARCH_MAX_MATCHES{ std::size_t{ 1 } << 21 };
+
+// Appends the offset of every occurrence of needle in text to 'out',
+// overlapping ones included. The SIMD scanners compare the first and the last
+// byte of the needle against 16 or 32 positions at a time and only compare
+// the rest where both match. 'automatic' picks the widest one the CPU supports.
+void Scan(std::string_view text,
+  std::string_view needle,
+  std::vector<std::size_t> &out,
+  edit::scanner s = edit::scanner::automatic);
+
+// The text from a match on, at least to the end of its row, and a copy of
+// its first bytes: narrowing mostly gets by with those, so it doesn't have to
+// touch the pages of a mapped file again
+struct tail
+{
+  std::string_view rest;
+  char head[15];
+  unsigned char length;
+};
+
+// A match: the row it is in, its offset in the row's chars and its length
+struct match
+{
+  std::size_t row;
+  std::size_t col;
+  std::size_t length;
+
+  bool operator==(const match &) const = default;
+};
+
+// All matches of a query in a buffer, in order. When the query grows by
+// characters typed at its end, only the previous matches are checked again
+// instead of the whole buffer. The buffer must not change in between; call
+// clear() when it does. Queries must not contain line terminators.
+//
+// A query can also be a regular expression, see pattern. It is compiled once
+// per query, and every row is matched against it again as the query changes.
+//
+// A large buffer is searched in slices on the shared thread pool, in the
+// background: matches() grows as poll() or wait() collect the slices that
+// are done, in order, and a new query cancels the search still running.
+class matchIndex
+{
+public:
+  matchIndex();
+  ~matchIndex();
+
+  matchIndex(const matchIndex &) = delete;
+  matchIndex &operator=(const matchIndex &) = delete;
+
+  void update(const edit::rowBuffer &rows, std::string_view query, bool regex = false);
+  void clear();
+
+  // Collects the matches of slices that are done. Returns true once the
+  // whole search is.
+  bool poll();
+  // Like poll(), but waits up to 'timeout' for the search to end
+  bool wait(std::chrono::milliseconds timeout);
+
+  const std::string &text() const { return query; }
+  const std::vector<match> &matches() const { return found; }
+  // Hands the matches over and clears the index, letting go of its snapshot
+  // of the rows, so that rows can be changed without being copied first
+  std::vector<match> release();
+  // Why the query is not a valid regular expression, or empty
+  const std::string &error() const { return invalid; }
+  // False while searching, and if the query matched more than
+  // KILO_SEARCH_MAX_MATCHES times. The matches kept are then those of the
+  // rows before the one that overflowed, and searching for a longer query
+  // goes on from that row.
+  bool complete() const { return !job && !truncated; }
+
+private:
+  struct scanJob;
+
+  void start(std::size_t from);
+  void cancel();
+  void narrow();
+
+  std::string query{};
+  bool regex{ false };
+  std::unique_ptr<pattern> compiled{};// for the query, when regex
+  std::string invalid{};
+  std::vector<match> found{};
+  std::vector<tail> rest{};
+  bool truncated{ false };
+  std::size_t resume{};// first row not searched when truncated
+  // Keeps what rest points into alive while rows are being copied on write
+  edit::rowSnapshot held{};
+  std::unique_ptr<scanJob> job{};
+};
+
+}// end namespace search
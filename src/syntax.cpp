@@ -1,186 +1,267 @@
 #include "syntax.h"
 #include "edit.h"
+#include "language.h"
+#include "lexer.h"
+#include "pool.h"
+
+#include <algorithm>
+#include <deque>
+#include <future>
+#include <set>
+#include <utility>
+#include <vector>
 
 #include <cstring>
 
 namespace syntax {
 
+// Each chunk of a parallel highlighting pass gets at least this many rows
+const std::size_t HL_PARALLEL_MIN_ROWS{ 2048 };
+// Rows above the screen Ensure() moves the watermark over at most, a couple
+// of milliseconds' worth; idle slices of Advance() do the rest
+const std::size_t HL_CATCH_UP_ROWS{ 4096 };
 
-#define HL_HIGHLIGHT_NUMBERS (1 << 0)
-#define HL_HIGHLIGHT_STRINGS (1 << 1)
-
-// /*** filetypes ***/
-
-const char *C_HL_extensions[] = { ".c", ".h", ".cpp", nullptr };
-const char *C_HL_keywords[] = { "switch",
-  "if",
-  "while",
-  "for",
-  "break",
-  "continue",
-  "return",
-  "else",
-  "struct",
-  "union",
-  "typedef",
-  "static",
-  "enum",
-  "class",
-  "case",
-  "int|",
-  "long|",
-  "double|",
-  "float|",
-  "char|",
-  "unsigned|",
-  "signed|",
-  "void|",
-  nullptr };
-
-struct edit::editorSyntax HLDB[] = {
-  { "c", C_HL_extensions, C_HL_keywords, "//", "/*", "*/", HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS },
-};
-
-#define HLDB_ENTRIES (sizeof(HLDB) / sizeof(HLDB[0]))
-
-// /*** syntax highlighting ***/
+// /*** keywords ***/
 
 bool is_separator(const char c) { return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != nullptr; }
 
-void Update(edit::editorConfig &E, edit::erow &row)
+keywordTable::keywordTable(const char **keywords)
 {
-  row.hl = static_cast<unsigned char *>(realloc(row.hl, row.rsize));
-  memset(row.hl, HL_NORMAL, row.rsize);
+  std::vector<std::pair<std::string_view, unsigned char>> regular;
+  std::set<std::string_view> seen;
+  for (auto **k = keywords; k && *k; k++) {
+    std::string_view word(*k);
+    unsigned char hl = HL_KEYWORD1;
+    if (word.ends_with('|')) {
+      word.remove_suffix(1);
+      hl = HL_KEYWORD2;
+    }
+    // The first of two equal keywords wins, as it did when they were tried
+    // in order
+    if (word.empty() || !seen.insert(word).second) continue;
+    if (std::any_of(word.begin(), word.end(), is_separator)) {
+      irregular.emplace_back(word, hl);
+    } else {
+      regular.emplace_back(word, hl);
+    }
+  }
+  count = regular.size() + irregular.size();
 
-  if (E.syntax == nullptr) return;
+  // Hash and displace: the keywords are put into buckets by a first hash,
+  // then, biggest bucket first, each bucket gets a seed for a second hash
+  // that puts all its keywords into slots still free
+  std::size_t size = 1;
+  while (size < 2 * regular.size()) size <<= 1;
+  mask = size - 1;
+  slots.assign(size, slot{ 0, 0, HL_NORMAL });
+  seeds.assign(std::max<std::size_t>(1, (regular.size() + 1) / 2), 0);
 
-  const auto **keywords = E.syntax->keywords;
+  std::vector<std::vector<std::size_t>> buckets(seeds.size());
+  for (std::size_t i = 0; i < regular.size(); i++) buckets[hash(regular[i].first, 0) % seeds.size()].push_back(i);
+  std::vector<std::size_t> order(buckets.size());
+  for (std::size_t b = 0; b < order.size(); b++) order[b] = b;
+  std::stable_sort(order.begin(), order.end(), [&](auto a, auto b) { return buckets[a].size() > buckets[b].size(); });
 
-  const auto *scs = E.syntax->singleline_comment_start;
-  const auto *mcs = E.syntax->multiline_comment_start;
-  const auto *mce = E.syntax->multiline_comment_end;
+  std::vector<bool> used(size);
+  std::vector<std::size_t> placed;
+  for (auto b : order) {
+    if (buckets[b].empty()) break;
+    for (std::uint64_t seed = 1;; seed++) {
+      placed.clear();
+      for (auto i : buckets[b]) {
+        auto at = hash(regular[i].first, seed) & mask;
+        if (used[at] || std::find(placed.begin(), placed.end(), at) != placed.end()) break;
+        placed.push_back(at);
+      }
+      if (placed.size() < buckets[b].size()) continue;
+      seeds[b] = seed;
+      for (std::size_t k = 0; k < placed.size(); k++) {
+        const auto &[word, hl] = regular[buckets[b][k]];
+        used[placed[k]] = true;
+        slots[placed[k]] = slot{ static_cast<std::uint32_t>(words.size()), static_cast<std::uint32_t>(word.size()), hl };
+        words += word;
+        shortest = std::min(shortest, word.size());
+        longest = std::max(longest, word.size());
+      }
+      break;
+    }
+  }
+}
 
-  auto scs_len = scs ? strlen(scs) : 0;
-  auto mcs_len = mcs ? strlen(mcs) : 0;
-  auto mce_len = mce ? strlen(mce) : 0;
+std::pair<std::size_t, unsigned char> keywordTable::findIrregular(const char *text) const
+{
+  for (const auto &[word, hl] : irregular) {
+    if (!strncmp(text, word.c_str(), word.size()) && is_separator(text[word.size()])) return { word.size(), hl };
+  }
+  return { 0, HL_NORMAL };
+}
 
-  auto prev_sep = true;
-  auto in_string = 0;
-  auto in_comment = (row.idx > 0 && E.row[row.idx - 1].hl_open_comment);
+void Compile(edit::editorSyntax &syntax)
+{
+  // Syntaxes live as long as the program, and so do their lexers
+  static std::deque<lexer> lexers;
+  if (!syntax.lexer) syntax.lexer = &lexers.emplace_back(syntax);
+}
 
-  size_t i = 0;
-  while (i < row.rsize) {
-    auto c = row.render.at(i);
-    auto prev_hl = (i > 0) ? row.hl[i - 1] : HL_NORMAL;
+// /*** syntax highlighting ***/
 
-    if (scs_len && !in_string && !in_comment) {
-      if (!strncmp(&row.render.at(i), scs, scs_len)) {
-        memset(&row.hl[i], HL_COMMENT, row.rsize - i);
-        break;
-      }
-    }
+// Lexes a row into 'runs' without changing it, and returns whether a
+// multi-line comment is open at its end
+static int Lex(const edit::editorSyntax *syntax, const edit::erow &row, int in_comment, std::vector<span> &runs)
+{
+  runs.clear();
+  if (syntax == nullptr || syntax->lexer == nullptr) return 0;
+  return syntax->lexer->run(std::string_view(row.render().data(), row.rsize), in_comment, runs);
+}
 
-    if (mcs_len && mce_len && !in_string) {
-      if (in_comment) {
-        row.hl[i] = HL_MLCOMMENT;
-        if (!strncmp(&row.render.at(i), mce, mce_len)) {
-          memset(&row.hl[i], HL_MLCOMMENT, mce_len);
-          i += mce_len;
-          in_comment = 0;
-          prev_sep = true;
-          continue;
-        } else {
-          i++;
-          continue;
-        }
-      } else if (!strncmp(&row.render.at(i), mcs, mcs_len)) {
-        memset(&row.hl[i], HL_MLCOMMENT, mcs_len);
-        i += mcs_len;
-        in_comment = 1;
-        continue;
-      }
-    }
+// Highlights a single row, given whether a multi-line comment is open at its
+// start, and returns whether one is still open at its end. Only touches the
+// row itself, so different rows can be highlighted on different threads.
+int Highlight(const edit::editorSyntax *syntax, edit::erow &row, int in_comment)
+{
+  // One vector per thread, as rows are highlighted in parallel
+  static thread_local std::vector<span> runs;
+  in_comment = Lex(syntax, row, in_comment, runs);
+  row.highlight(runs);
 
-    if (E.syntax->flags & HL_HIGHLIGHT_STRINGS) {
-      if (in_string) {
-        row.hl[i] = HL_STRING;
-        if (c == '\\' && i + 1 < row.rsize) {
-          row.hl[i + 1] = HL_STRING;
-          i += 2;
-          continue;
-        }
-        if (c == in_string) in_string = 0;
-        i++;
-        prev_sep = true;
-        continue;
-      } else {
-        if (c == '"' || c == '\'') {
-          in_string = static_cast<unsigned char>(c);
-          row.hl[i] = HL_STRING;
-          i++;
-          continue;
-        }
-      }
-    }
+  return row.hl_open_comment = in_comment;
+}
 
-    if (E.syntax->flags & HL_HIGHLIGHT_NUMBERS) {
-      if ((isdigit(c) && (prev_sep || prev_hl == HL_NUMBER)) || (c == '.' && prev_hl == HL_NUMBER)) {
-        row.hl[i] = HL_NUMBER;
-        i++;
-        prev_sep = false;
-        continue;
-      }
-    }
+// Highlights row 'at' of the buffer like Highlight(), but only takes the row
+// for writing if its highlighting changes: rows that are highlighted again
+// without having changed, like those past the watermark each time they are
+// drawn, then cost no copy of a chunk that a snapshot shares.
+int Highlight(edit::editorConfig &E, std::size_t at, int in_comment)
+{
+  static std::vector<span> runs;
+  const auto &row = std::as_const(E.row)[at];
+  in_comment = Lex(E.syntax, row, in_comment, runs);
+  if (row.hl_open_comment == in_comment && std::ranges::equal(row.highlight(), runs)) return in_comment;
 
-    if (prev_sep) {
-      int j;
-      for (j = 0; keywords[j]; j++) {
-        auto klen = strlen(keywords[j]);
-        auto kw2 = keywords[j][klen - 1] == '|';
-        if (kw2) klen--;
-
-        if (!strncmp(&row.render[i], keywords[j], klen) && is_separator(row.render[i + klen])) {
-          memset(&row.hl[i], kw2 ? HL_KEYWORD2 : HL_KEYWORD1, klen);
-          i += klen;
-          break;
-        }
-      }
-      if (keywords[j] != nullptr) {
-        prev_sep = false;
-        continue;
-      }
-    }
+  auto &changed = E.row[at];
+  changed.highlight(runs);
+  return changed.hl_open_comment = in_comment;
+}
+
+// Comment state at the end of row 'at', as far as it is known
+int OpenCommentBefore(const edit::editorConfig &E, std::size_t at)
+{
+  return at > 0 && E.row.loaded(at - 1) && E.row[at - 1].hl_open_comment;
+}
 
-    prev_sep = is_separator(c);
+void Update(edit::editorConfig &E, std::size_t at)
+{
+  // Past the watermark the row only needs to look right until the watermark
+  // catches up with it
+  if (at > E.hl_valid) {
+    Highlight(E, at, OpenCommentBefore(E, at));
+    return;
+  }
+
+  // Re-highlight the following rows for as long as the comment state they
+  // start in changes, but not past the end of the screen: what is below is
+  // left to Ensure() once it gets drawn.
+  auto valid = E.hl_valid;
+  auto limit = std::max(E.rowoff + static_cast<std::size_t>(E.screenrows), at + 1);
+  auto in_comment = OpenCommentBefore(E, at);
+  for (auto i = at; i < E.numrows;) {
+    auto was_open = std::as_const(E.row)[i].hl_open_comment;
+    in_comment = Highlight(E, i, in_comment);
     i++;
+    if (i >= valid || (in_comment != was_open && i >= limit)) {
+      E.hl_valid = i;
+      break;
+    }
+    if (in_comment == was_open) break;
+  }
+}
+
+void Ensure(edit::editorConfig &E, std::size_t from, std::size_t to)
+{
+  // Catch the watermark up, but not by more than a bounded number of rows
+  // above the screen, nor by reading rows of a mapped file that are not on it
+  auto limit = E.hl_valid + HL_CATCH_UP_ROWS;
+  while (E.hl_valid < to && (E.hl_valid >= from || (E.hl_valid < limit && E.row.loaded(E.hl_valid)))) {
+    Highlight(E, E.hl_valid, OpenCommentBefore(E, E.hl_valid));
+    E.hl_valid++;
   }
 
-  auto changed = (row.hl_open_comment != in_comment);
-  row.hl_open_comment = in_comment;
-  if (changed && row.idx + 1 < E.numrows) Update(E, E.row[row.idx + 1]);
+  // Whatever is still past it gets a best guess at its comment state, made
+  // right when the watermark gets there
+  for (auto i = std::max(from, E.hl_valid); i < to; i++) Highlight(E, i, OpenCommentBefore(E, i));
 }
 
+bool Advance(edit::editorConfig &E, std::size_t rows)
+{
+  auto end = std::min(E.numrows, E.hl_valid + rows);
+  while (E.hl_valid < end && E.row.loaded(E.hl_valid)) {
+    Highlight(E, E.hl_valid, OpenCommentBefore(E, E.hl_valid));
+    E.hl_valid++;
+  }
+  return E.hl_valid < E.numrows && E.row.loaded(E.hl_valid);
+}
 
-void SelectHighlight(edit::editorConfig &E)
+void HighlightAll(edit::editorConfig &E)
 {
-  E.syntax = nullptr;
-  if (E.filename.empty()) return;
+  // Rows of a mapped file that have not been read are left to Ensure()
+  std::vector<edit::erow *> rows;
+  rows.reserve(E.numrows);
+  for (std::size_t filerow = 0; filerow < E.numrows && E.row.loaded(filerow); filerow++) {
+    rows.push_back(&E.row[filerow]);
+  }
+  E.hl_valid = rows.size();
 
-  for (auto j = 0; j != HLDB_ENTRIES; ++j) {
-    auto *s = &HLDB[j];
-    unsigned int i = 0;
-    while (s->filematch[i]) {
-      auto is_ext = (s->filematch[i][0] == '.');
-      if ((is_ext && E.filename.ends_with(s->filematch[i])) || (!is_ext && E.filename.starts_with(s->filematch[i]))) {
-        E.syntax = s;
+  auto &workers = pool::Shared();
+  auto nchunks = std::min(workers.size() * 4, rows.size() / HL_PARALLEL_MIN_ROWS);
+  if (nchunks < 2) {
+    int in_comment = 0;
+    for (auto *r : rows) in_comment = Highlight(E.syntax, *r, in_comment);
+    return;
+  }
 
-        for (std::size_t filerow = 0; filerow < E.numrows; filerow++) { syntax::Update(E, E.row[filerow]); }
+  // Highlight every chunk speculatively, as if no comment is open at its start
+  std::vector<std::size_t> bounds;
+  for (std::size_t c = 0; c <= nchunks; c++) bounds.push_back(rows.size() * c / nchunks);
+  std::vector<std::future<void>> done;
+  for (std::size_t c = 0; c < nchunks; c++) {
+    done.push_back(workers.submit([&, c] {
+      int in_comment = 0;
+      for (auto i = bounds[c]; i < bounds[c + 1]; i++) in_comment = Highlight(E.syntax, *rows[i], in_comment);
+    }));
+  }
+  for (auto &f : done) f.get();
 
-        return;
-      }
+  // Re-highlight from the start of each chunk that was entered with a comment
+  // open, until the state at the end of a row matches the speculative one,
+  // whichever way it differed: a row can close the comment and open another.
+  // The walk goes on across the end of a chunk; the next chunk is then only
+  // looked at again if the walk stopped right at its start.
+  std::size_t fixed = 0;// rows before this one are known to be right
+  for (std::size_t c = 1; c < nchunks; c++) {
+    if (fixed > bounds[c] || !rows[bounds[c] - 1]->hl_open_comment) continue;
+    auto in_comment = rows[bounds[c] - 1]->hl_open_comment;
+    auto i = bounds[c];
+    while (i < rows.size()) {
+      auto was_open = rows[i]->hl_open_comment;
+      in_comment = Highlight(E.syntax, *rows[i], in_comment);
       i++;
+      if (in_comment == was_open) break;
     }
+    fixed = i;
   }
 }
 
+
+void SelectHighlight(edit::editorConfig &E)
+{
+  E.syntax = nullptr;
+  if (E.filename.empty()) return;
+
+  E.syntax = Languages().find(E.filename);
+  if (E.syntax == nullptr) return;
+  Compile(*E.syntax);
+
+  HighlightAll(E);
+}
+
 }// end namespace syntax
@@ -2,8 +2,18 @@
 
 #include "edit.h"
 
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 namespace syntax {
 
+#define HL_HIGHLIGHT_NUMBERS (1 << 0)
+#define HL_HIGHLIGHT_STRINGS (1 << 1)
+
 enum editorHighlight {
   HL_NORMAL = 0,
   HL_COMMENT,
@@ -15,8 +25,75 @@ enum editorHighlight {
   HL_MATCH
 };
 
+// Whitespace, '\0' and the punctuation that ends a token
+bool is_separator(const char c);
+
+// The keywords of a syntax, as a perfect hash table: a token, the run of
+// characters between two separators, is classified with one hash of it and
+// one comparison, however many keywords there are. Keywords ending in '|'
+// are HL_KEYWORD2. The rare keyword with a separator in it can't be looked
+// up as a token; those are compared one by one, when a token is no keyword.
+class keywordTable
+{
+public:
+  explicit keywordTable(const char **keywords);
+
+  // HL_KEYWORD1 or HL_KEYWORD2 if the token is a keyword, HL_NORMAL if not
+  unsigned char find(std::string_view token) const
+  {
+    if (token.size() < shortest || token.size() > longest) return HL_NORMAL;
+    auto bucket = hash(token, 0) % seeds.size();
+    const auto &s = slots[hash(token, seeds[bucket]) & mask];
+    if (s.length != token.size() || memcmp(words.data() + s.offset, token.data(), token.size()) != 0) return HL_NORMAL;
+    return s.hl;
+  }
+  // Length and class of a keyword with a separator in it that 'text' starts
+  // with, followed by a separator; 0 and HL_NORMAL if there is none
+  std::pair<std::size_t, unsigned char> findIrregular(const char *text) const;
+  std::size_t size() const { return count; }
+  bool hasIrregular() const { return !irregular.empty(); }
+
+private:
+  struct slot
+  {
+    std::uint32_t offset;// of the keyword in words
+    std::uint32_t length;// 0 for an empty slot
+    unsigned char hl;
+  };
+
+  static std::uint64_t hash(std::string_view s, std::uint64_t seed)
+  {
+    std::uint64_t h = 0xcbf29ce484222325ULL ^ (seed * 0x9e3779b97f4a7c15ULL);
+    for (unsigned char c : s) h = (h ^ c) * 0x100000001b3ULL;
+    return h ^ (h >> 29);
+  }
+
+  std::string words{};
+  std::vector<std::uint64_t> seeds{};// per bucket of the first hash
+  std::vector<slot> slots{};
+  std::size_t mask{};
+  std::size_t shortest{ SIZE_MAX };
+  std::size_t longest{};
+  std::size_t count{};
+  std::vector<std::pair<std::string, unsigned char>> irregular{};
+};
+
+// Compiles the rules of a syntax into its lexer, once.
+// SelectHighlight() does this for the syntax it picks.
+void Compile(edit::editorSyntax &);
 
-void Update(edit::editorConfig &, edit::erow &);
+// Re-highlights a row after it changed, and the rows after it whose comment
+// state changed as a result, as far as the end of the screen
+void Update(edit::editorConfig &, std::size_t);
+// Makes sure rows [from, to) are highlighted before they are drawn. When the
+// watermark is far above them, they get a best guess for now and are put
+// right by Advance().
+void Ensure(edit::editorConfig &, std::size_t from, std::size_t to);
+// Moves the watermark over up to 'rows' more loaded rows. Returns true while
+// there are loaded rows left past it.
+bool Advance(edit::editorConfig &, std::size_t rows);
+// Highlights every loaded row, in parallel chunks for large files
+void HighlightAll(edit::editorConfig &);
 void SelectHighlight(edit::editorConfig &);
 
 }// end namespace syntax
@@ -130,6 +130,11 @@ inline std::string erase_to_eol()
     return "\x1b[K";
 }
 
+inline std::string clear_screen()
+{
+    return "\x1b[2J";
+}
+
 enum Key {
     BACKSPACE = 1000,
     ENTER,
@@ -163,19 +168,34 @@ enum Key {
     F10,
     F11,
     F12,
+    PASTE,
 };
 
 class Terminal: public BaseTerminal {
     bool restore_screen_;
+    bool bracketed_paste_;
+    mutable std::string paste_;
 public:
     Terminal(bool enable_keyboard=false, bool disable_ctrl_c=true)
         : BaseTerminal(enable_keyboard, disable_ctrl_c),
-          restore_screen_{false} {}
+          restore_screen_{false}, bracketed_paste_{false} {}
 
     virtual ~Terminal() {
+        if (bracketed_paste_) write("\033[?2004l");
         restore_screen();
     }
 
+    // Asks the terminal to mark pasted text, which read_key() then returns
+    // as a single Key::PASTE instead of one key per character
+    void enable_bracketed_paste()
+    {
+        bracketed_paste_ = true;
+        write("\033[?2004h");
+    }
+
+    // The text of the last Key::PASTE
+    const std::string& paste() const { return paste_; }
+
     void restore_screen()
     {
         if (restore_screen_) {
@@ -197,11 +217,16 @@ public:
         std::cout << s << std::flush;
     }
 
-    // Waits for a key press, translates escape codes
+    // Waits for a key press, translates escape codes. Returns 0 once the
+    // terminal hung up.
     int read_key() const
     {
         int key;
-        while ((key = read_key0()) == 0) { }
+        while ((key = read_key0()) == 0) {
+            if (input_closed())
+                return 0;
+            wait_input();
+        }
         return key;
     }
 
@@ -278,6 +303,13 @@ public:
                             if (!read_raw(&seq[3])) {
                                 return -3;
                             }
+                            if (seq[1] == '2' && seq[2] == '0' && seq[3] == '0') {
+                                if (!read_raw(&seq[3]) || seq[3] != '~') {
+                                    return -13;
+                                }
+                                read_paste();
+                                return Key::PASTE;
+                            }
                             if (seq[3] == '~') {
                                 if (seq[1] == '1') {
                                     switch (seq[2]) {
@@ -377,6 +409,28 @@ public:
         }
     }
 
+    // Collects pasted text up to the closing "\033[201~"
+    void read_paste() const
+    {
+        static const char end[] = "\033[201~";
+        const std::size_t endlen = sizeof(end) - 1;
+        paste_.clear();
+        char c;
+        while (true) {
+            while (!read_raw(&c)) {
+                if (input_closed())
+                    return;
+                wait_input();
+            }
+            paste_.push_back(c);
+            if (c == '~' && paste_.size() >= endlen &&
+                    paste_.compare(paste_.size() - endlen, endlen, end) == 0) {
+                paste_.resize(paste_.size() - endlen);
+                return;
+            }
+        }
+    }
+
     void get_cursor_position(int& rows, int& cols) const
     {
         char buf[32];
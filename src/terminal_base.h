@@ -17,6 +17,7 @@
 #    include <windows.h>
 #    include <io.h>
 #else
+#    include <poll.h>
 #    include <sys/ioctl.h>
 #    include <termios.h>
 #undef B0
@@ -62,6 +63,29 @@ private:
     UINT in_code_page;
 #else
     struct termios orig_termios;
+    // Bytes already read from the terminal but not handed out yet
+    mutable char inbuf[4096];
+    mutable long inpos = 0;
+    mutable long inlen = 0;
+    // Set once the terminal hung up: poll() reports it readable, yet there
+    // is nothing to read
+    mutable bool hungup = false;
+
+    // Reads what is available into inbuf; returns what read() did
+    long fill() const
+    {
+        long nread = read(STDIN_FILENO, inbuf, sizeof(inbuf));
+        if (nread == -1 && errno == EIO) {
+            hungup = true;
+        } else if (nread == -1 && errno != EAGAIN) {
+            throw std::runtime_error("read() failed");
+        }
+        if (nread > 0) {
+            inpos = 0;
+            inlen = nread;
+        }
+        return nread;
+    }
 #endif
     bool keyboard_enabled;
 
@@ -161,7 +185,8 @@ public:
             }
         }
 #else
-        if (keyboard_enabled) {
+        // A terminal that hung up has no settings left to restore
+        if (keyboard_enabled && !hungup) {
             if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &orig_termios) == -1) {
                 throw std::runtime_error("tcsetattr() failed in destructor");
             }
@@ -189,11 +214,47 @@ public:
             return false;
         }
 #else
-        long nread = read(STDIN_FILENO, s, 1);
-        if (nread == -1 && errno != EAGAIN) {
-            throw std::runtime_error("read() failed");
-        }
-        return (nread == 1);
+        // Everything available is read at once, so that pasted text doesn't
+        // cost one system call per byte
+        if (inpos == inlen && fill() <= 0)
+            return false;
+        *s = inbuf[inpos++];
+        return true;
+#endif
+    }
+
+    // Sleeps until there is input to read, or the terminal hung up
+    void wait_input() const
+    {
+#ifndef _WIN32
+        if (inpos < inlen || hungup)
+            return;
+        struct pollfd p{STDIN_FILENO, POLLIN, 0};
+        while (poll(&p, 1, -1) == -1 && errno == EINTR) { }
+        // A raw terminal reads nothing when there is nothing yet, so end of
+        // input shows as being woken up for nothing
+        if (p.revents != 0 && fill() == 0)
+            hungup = true;
+#endif
+    }
+
+    // True once no more input can come, after which read_key() returns 0
+    bool input_closed() const
+    {
+#ifdef _WIN32
+        return false;
+#else
+        return hungup;
+#endif
+    }
+
+    // Returns true if input has been read but not consumed yet
+    bool input_pending() const
+    {
+#ifdef _WIN32
+        return _kbhit();
+#else
+        return inpos < inlen;
 #endif
     }
 
@@ -1,12 +1,18 @@
 #include "tui.h"
 #include "edit.h"
 #include "row.h"
+#include "screen.h"
+#include "search.h"
 #include "syntax.h"
 
-#include <fstream>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 #include <memory>
 #include <stdexcept>
+#include <system_error>
+#include <string_view>
+#include <utility>
 
 #include <cctype>
 #include <cerrno>
@@ -16,6 +22,7 @@
 #include <cstring>
 #include <ctime>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/types.h>
 
 using Term::Terminal;
@@ -52,8 +59,30 @@ auto SyntaxToColor(const int hl)
 }
 
 
+// The save running in the background, if any
+static std::unique_ptr<edit::saveJob> saving;
+
+// Waits for the running save to end and reports how it went
+static void FinishSave(edit::editorConfig &E)
+{
+  char buf[256];
+  try {
+    auto len = saving->finish(E);
+    snprintf(buf, sizeof(buf), "%zu bytes written to disk", len);
+  } catch (const std::system_error &e) {
+    snprintf(buf, sizeof(buf), "Can't save! I/O error: %s", e.code().message().c_str());
+  }
+  saving.reset();
+  SetStatusMessage(E, buf);
+}
+
 void Save(edit::editorConfig &E, const Term::Terminal &term)
 {
+  if (saving) {
+    SetStatusMessage(E, "Still saving, try again when done");
+    return;
+  }
+
   if (E.filename.empty()) {
     E.filename = Prompt(E, term, "Save as: ", " (ESC to cancel)", nullptr);
     if (E.filename.empty()) {
@@ -63,74 +92,74 @@ void Save(edit::editorConfig &E, const Term::Terminal &term)
     syntax::SelectHighlight(E);
   }
 
-  int len;
-  char *buf = edit::RowsToString(&len);
-  std::string s = std::string(buf, static_cast<std::size_t>(len));
-  free(buf);
+  try {
+    saving = std::make_unique<edit::saveJob>(E);
+  } catch (const std::system_error &e) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "Can't save! %s", e.what());
+    SetStatusMessage(E, buf);
+  }
+}
+
+bool Background(edit::editorConfig &E)
+{
+  if (saving && saving->done(E)) FinishSave(E);
+  return saving || E.row.indexing();
+}
 
-  std::ofstream out;
-  out.open(E.filename);
-  out << s;
-  out.close();
-  E.dirty = 0;
-  /* editorSetStatusMessage("Can't save! I/O error: %s", strerror(errno)); */
+void Wait(edit::editorConfig &E)
+{
+  if (saving) FinishSave(E);
 }
 
 // /*** find ***/
 
-void FindCallback(edit::editorConfig &E, char *query, int key)
-{
-  static int last_match = -1;
-  static int direction = 1;
+// Matches of the query being typed, found in the background and narrowed as
+// it grows. Every match on screen is drawn highlighted; see DrawMatches().
+static search::matchIndex found;
+static std::size_t current = 0;// the match the cursor is on
+static bool regex = false;// Ctrl-T in the prompt switches between literal and regex
+static const Terminal *in = nullptr;
 
-  static int saved_hl_line;
-  static char *saved_hl = nullptr;
+// Moves the cursor to the current match
+static void ShowMatch(edit::editorConfig &E)
+{
+  const auto &matches = found.matches();
+  if (current >= matches.size()) return;
+  E.cy = matches[current].row;
+  E.cx = matches[current].col;
+  E.rowoff = E.numrows;
+}
 
-  if (saved_hl) {
-    memcpy(E.row[saved_hl_line].hl, saved_hl, E.row[saved_hl_line].rsize);
-    free(saved_hl);
-    saved_hl = nullptr;
-  }
+void FindCallback(edit::editorConfig &E, char *query, int key)
+{
   if (key == Term::Key::ENTER || key == Term::Key::ESC) {
-    last_match = -1;
-    direction = 1;
+    found.clear();
+    current = 0;
     return;
-  } else if (key == Term::Key::ARROW_RIGHT || key == Term::Key::ARROW_DOWN) {
-    direction = 1;
-  } else if (key == Term::Key::ARROW_LEFT || key == Term::Key::ARROW_UP) {
-    direction = -1;
-  } else {
-    last_match = -1;
-    direction = 1;
   }
 
-  if (last_match == -1) direction = 1;
-  int current = last_match;
-  int i;
-  for (i = 0; i < static_cast<int>(E.numrows); i++) {
-    current += direction;
-    if (current == -1)
-      current = static_cast<int>(E.numrows) - 1;
-    else if (current == static_cast<int>(E.numrows))
-      current = 0;
-
-    edit::erow &row = E.row[current];
-    auto pos = row.render.find(query);
-
-    if (std::string::npos != pos) {
-      char *match = &row.render.at(pos);
-      last_match = current;
-      E.cy = static_cast<std::size_t>(current);
-      E.cx = row::RxToCx(row, static_cast<std::size_t>(match - row.render.c_str()));
-      E.rowoff = E.numrows;
-
-      saved_hl_line = current;
-      saved_hl = static_cast<char *>(malloc(row.size));
-      memcpy(saved_hl, row.hl, row.rsize);
-      memset(&row.hl[match - row.render.c_str()], syntax::HL_MATCH, strlen(query));
-      break;
+  const auto &matches = found.matches();
+  if (key == Term::Key::ARROW_RIGHT || key == Term::Key::ARROW_DOWN) {
+    if (!matches.empty()) current = (current + 1) % matches.size();
+  } else if (key == Term::Key::ARROW_LEFT || key == Term::Key::ARROW_UP) {
+    if (!matches.empty()) current = (current + matches.size() - 1) % matches.size();
+  } else {
+    if (key == CTRL_KEY('t')) regex = !regex;
+    found.update(E.row, query, regex);
+    current = 0;
+    // Show the matches as they come in, but stop waiting as soon as another
+    // key arrives: it either cancels this search or steps through what has
+    // been found so far
+    std::string ab;
+    while (!found.wait(std::chrono::milliseconds(50))) {
+      struct pollfd p{ STDIN_FILENO, POLLIN, 0 };
+      if (in->input_pending() || poll(&p, 1, 0) > 0) break;
+      ShowMatch(E);
+      Present(E, ab);
     }
   }
+  ShowMatch(E);
 }
 
 void Find(edit::editorConfig &E, const Term::Terminal &term)
@@ -140,7 +169,7 @@ void Find(edit::editorConfig &E, const Term::Terminal &term)
   auto saved_coloff = E.coloff;
   auto saved_rowoff = E.rowoff;
 
-  char *query = Prompt(E, term, "Search: ", " (ESC/Arrows/Enter)", FindCallback);
+  char *query = Prompt(E, term, "Search: ", " (ESC/Arrows/Enter, Ctrl-T regex)", FindCallback);
 
   if (query) {
     free(query);
@@ -152,12 +181,73 @@ void Find(edit::editorConfig &E, const Term::Terminal &term)
   }
 }
 
+void Replace(edit::editorConfig &E, const Term::Terminal &term)
+{
+  auto saved_cx = E.cx;
+  auto saved_cy = E.cy;
+  auto saved_coloff = E.coloff;
+  auto saved_rowoff = E.rowoff;
+
+  char *query = Prompt(E, term, "Replace: ", " (ESC/Arrows/Enter, Ctrl-T regex)", FindCallback);
+  // Replacing with nothing deletes the matches
+  char *with = query ? Prompt(E, term, "With: ", " (ESC to cancel)", nullptr, true) : nullptr;
+  E.cx = saved_cx;
+  E.cy = saved_cy;
+  E.coloff = saved_coloff;
+  E.rowoff = saved_rowoff;
+  if (!with) {
+    free(query);
+    return;
+  }
+
+  // Every match has to be known before the rows change under the index
+  found.update(E.row, query, regex);
+  found.wait(std::chrono::hours(24));
+  char buf[80];
+  if (!found.error().empty()) {
+    snprintf(buf, sizeof(buf), "Bad regex: %s", found.error().c_str());
+  } else {
+    auto more = found.complete() ? "" : " (more left, stopped at the match limit)";
+    // While the index holds its snapshot, every chunk changed would be copied
+    auto matches = found.release();
+    snprintf(buf, sizeof(buf), "Replaced %zu occurrences%s", edit::ReplaceAll(E, matches, with), more);
+  }
+  found.clear();
+  SetStatusMessage(E, buf);
+  free(query);
+  free(with);
+}
+
 /*** output ***/
 
-void DrawRows(edit::editorConfig &E, std::string &ab)
+// Draws the matches in row 'filerow' over the row as DrawRows() drew it,
+// leaving the row's own highlighting alone
+static void DrawMatches(edit::editorConfig &E, screen::frame &f, std::size_t fy, std::size_t filerow)
+{
+  const auto &matches = found.matches();
+  auto it = std::lower_bound(matches.begin(), matches.end(), filerow, [](const search::match &m, std::size_t row) {
+    return m.row < row;
+  });
+  const auto &row = std::as_const(E.row)[filerow];
+  auto render = row.render();
+  auto color = screen::Attr(SyntaxToColor(syntax::HL_MATCH));
+  auto right = E.coloff + static_cast<std::size_t>(E.screencols);
+  for (; it != matches.end() && it->row == filerow; ++it) {
+    auto from = std::max(row::CxToRx(row, it->col), E.coloff);
+    auto to = std::min(row::CxToRx(row, it->col + it->length), right);
+    for (auto x = from; x < to; x++) {
+      if (!iscntrl(render[x])) f.set(fy, x - E.coloff, render[x], color);
+    }
+  }
+}
+
+void DrawRows(edit::editorConfig &E, screen::frame &f)
 {
+  syntax::Ensure(E, E.rowoff, std::min(E.numrows, E.rowoff + static_cast<std::size_t>(E.screenrows)));
+
   int y;
   for (y = 0; y < E.screenrows; y++) {
+    auto fy = static_cast<std::size_t>(y);
     int filerow = y + static_cast<int>(E.rowoff);
     if (filerow >= static_cast<int>(E.numrows)) {
       if (E.numrows == 0 && y == E.screenrows / 3) {
@@ -165,65 +255,85 @@ void DrawRows(edit::editorConfig &E, std::string &ab)
         int welcomelen = snprintf(welcome, sizeof(welcome), "Kilo editor -- version %s", edit::KILO_VERSION.c_str());
         if (welcomelen > E.screencols) welcomelen = E.screencols;
         int padding = (E.screencols - welcomelen) / 2;
-        if (padding) {
-          ab.append("~");
-          padding--;
-        }
-        while (padding--) ab.append(" ");
-        ab.append(welcome);
+        if (padding) f.set(fy, 0, '~');
+        f.print(fy, static_cast<std::size_t>(padding), welcome, static_cast<std::size_t>(welcomelen));
       } else {
-        ab.append("~");
+        f.set(fy, 0, '~');
       }
     } else {
-      int len = static_cast<int>(E.row[filerow].rsize) - static_cast<int>(E.coloff);
+      // Read through the const overload, so that drawing never copies a chunk
+      // that a snapshot shares
+      const auto &row = std::as_const(E.row)[static_cast<std::size_t>(filerow)];
+      int len = static_cast<int>(row.rsize) - static_cast<int>(E.coloff);
       if (len < 0) len = 0;
       if (len > E.screencols) len = E.screencols;
       if (len > 0) {// FIXME: Do we need this condition?
-        char *c = &E.row[filerow].render.at(E.coloff);
-        unsigned char *hl = &E.row[filerow].hl[E.coloff];
-        fg current_color = fg::black;// black is not used in editorSyntaxToColor
-        int j;
-        for (j = 0; j < len; j++) {
-          if (iscntrl(c[j])) {
-            char sym = (c[j] <= 26) ? '@' + c[j] : '?';
-            ab.append(color(style::reversed));
-            ab.append(std::string(&sym, 1));
-            ab.append(color(style::reset));
-            if (current_color != fg::black) { ab.append(color(current_color)); }
-          } else if (hl[j] == syntax::HL_NORMAL) {
-            if (current_color != fg::black) {
-              ab.append(color(fg::reset));
-              current_color = fg::black;
-            }
-            ab.append(std::string(&c[j], 1));
-          } else {
-            fg color = SyntaxToColor(hl[j]);
-            if (color != current_color) {
-              current_color = color;
-              ab.append(Term::color(color));
+        const char *c = row.render().data() + E.coloff;
+        auto n = static_cast<std::size_t>(len);
+        // The runs of the row are drawn one colour at a time, from the first
+        // that ends past the left edge; columns between them are plain
+        auto spans = row.highlight();
+        auto s = std::partition_point(spans.begin(), spans.end(), [&](const edit::hlSpan &sp) {
+          return sp.start + sp.length <= E.coloff;
+        });
+        std::size_t j = 0;
+        while (j < n) {
+          auto color = fg::reset;
+          auto end = n;
+          if (s != spans.end() && s->start <= E.coloff + j) {
+            color = SyntaxToColor(s->hl);
+            end = std::min(n, s->start + s->length - E.coloff);
+            ++s;
+          } else if (s != spans.end()) {
+            end = std::min(n, s->start - E.coloff);
+          }
+          while (j < end) {
+            if (iscntrl(c[j])) {
+              char sym = (c[j] <= 26) ? '@' + c[j] : '?';
+              f.set(fy, j, sym, screen::Attr(color, true));
+              j++;
+              continue;
             }
-            ab.append(std::string(&c[j], 1));
+            auto k = j + 1;
+            while (k < end && !iscntrl(c[k])) k++;
+            f.print(fy, j, &c[j], k - j, screen::Attr(color));
+            j = k;
           }
         }
-        ab.append(color(fg::reset));
       }
+      if (!found.matches().empty()) DrawMatches(E, f, fy, static_cast<std::size_t>(filerow));
     }
-
-    ab.append(erase_to_eol());
-    ab.append("\r\n");
   }
 }
 
-void DrawStatusBar(edit::editorConfig &E, std::string &ab)
+void DrawStatusBar(edit::editorConfig &E, screen::frame &f)
 {
-  ab.append(color(style::reversed));
-  char status[80], rstatus[80];
+  auto fy = static_cast<std::size_t>(E.screenrows);
+  auto reversed = screen::Attr(fg::reset, true);
+  char status[80], rstatus[80], progress[48] = "";
+  if (saving) {
+    auto lines = std::max<std::size_t>(saving->lines(), 1);
+    snprintf(progress, sizeof(progress), " [saving %u%%]", static_cast<unsigned int>(saving->linesWritten() * 100 / lines));
+  } else if (!found.error().empty()) {
+    snprintf(progress, sizeof(progress), " [regex: %s]", found.error().c_str());
+  } else if (!found.text().empty()) {
+    auto n = found.matches().size();
+    const char *more = found.complete() ? "" : "+";
+    const char *mode = regex ? "regex " : "";
+    if (n) {
+      snprintf(progress, sizeof(progress), " [%smatch %zu of %zu%s]", mode, current + 1, n, more);
+    } else {
+      snprintf(progress, sizeof(progress), " [no %smatches%s]", mode, found.complete() ? "" : " yet");
+    }
+  }
   int len = snprintf(status,
     sizeof(status),
-    "%.20s - %u lines %s",
+    "%.20s - %u%s lines %s%s",
     !E.filename.empty() ? E.filename.c_str() : "[No Name]",
     static_cast<unsigned int>(E.numrows),
-    E.dirty ? "(modified)" : "");
+    E.row.indexing() ? "+" : "",
+    E.dirty ? "(modified)" : "",
+    progress);
   int rlen = snprintf(rstatus,
     sizeof(rstatus),
     "%s | %u/%u",
@@ -231,47 +341,70 @@ void DrawStatusBar(edit::editorConfig &E, std::string &ab)
     static_cast<unsigned int>(E.cy) + 1,
     static_cast<unsigned int>(E.numrows));
   if (len > E.screencols) len = E.screencols;
-  ab.append(std::string(status, static_cast<std::size_t>(len)));
+  f.print(fy, 0, status, static_cast<std::size_t>(len), reversed);
   while (len < E.screencols) {
     if (E.screencols - len == rlen) {
-      ab.append(std::string(rstatus, static_cast<std::size_t>(rlen)));
+      f.print(fy, static_cast<std::size_t>(len), rstatus, static_cast<std::size_t>(rlen), reversed);
       break;
     } else {
-      ab.append(" ");
+      f.set(fy, static_cast<std::size_t>(len), ' ', reversed);
       len++;
     }
   }
-  ab.append(color(style::reset));
-  ab.append("\r\n");
 }
 
-void DrawMessageBar(edit::editorConfig &E, std::string &ab)
+void DrawMessageBar(edit::editorConfig &E, screen::frame &f)
 {
-  ab.append(erase_to_eol());
   int msglen = static_cast<int>(strlen(E.statusmsg));
   if (msglen > E.screencols) msglen = E.screencols;
   if (msglen && time(NULL) - E.statusmsg_time < 5)
-    ab.append(std::string(E.statusmsg, static_cast<std::size_t>(msglen)));
+    f.print(static_cast<std::size_t>(E.screenrows) + 1, 0, E.statusmsg, static_cast<std::size_t>(msglen));
 }
 
+// What the terminal currently shows, and the frame being drawn
+static screen::frame shown;
+static screen::frame next;
+
+// Where frames are written to, set up by init()
+static output::writer *out = nullptr;
+
+const std::string_view CURSOR_OFF{ "\x1b[?25l" };
+const std::string_view CURSOR_ON{ "\x1b[?25h" };
+const std::string_view CLEAR_SCREEN{ "\x1b[2J" };
+
 void RefreshScreen(edit::editorConfig &E, std::string &ab)
 {
+  edit::Poll(E);
   edit::Scroll();
 
-  ab.clear();
+  auto rows = static_cast<std::size_t>(E.screenrows) + 2;
+  auto cols = static_cast<std::size_t>(E.screencols);
+  if (next.rows() != rows || next.cols() != cols) next.resize(rows, cols);
+  next.clear();
 
-  ab.append(cursor_off());
-  ab.append(move_cursor(1, 1));
+  DrawRows(E, next);
+  DrawStatusBar(E, next);
+  DrawMessageBar(E, next);
 
-  DrawRows(E, ab);
-  DrawStatusBar(E, ab);
-  DrawMessageBar(E, ab);
+  ab.clear();
+  ab.append(CURSOR_OFF);
+  if (shown.rows() != rows || shown.cols() != cols) ab.append(CLEAR_SCREEN);
+  next.diff(shown, ab);
+  std::swap(shown, next);
 
-  ab.append(move_cursor((E.cy - E.rowoff) + 1, (E.rx - E.coloff) + 1));
+  screen::MoveCursor(ab, E.cy - E.rowoff, E.rx - E.coloff);
+  ab.append(CURSOR_ON);
+}
 
-  ab.append(cursor_on());
+void Present(edit::editorConfig &E, std::string &ab)
+{
+  if (out->busy() && out->wait(STDIN_FILENO)) return;
+  RefreshScreen(E, ab);
+  out->submit(ab);
 }
 
+void Repaint() { shown.resize(0, 0); }
+
 void SetStatusMessage(edit::editorConfig &E)
 {
   E.statusmsg[0] = '\0';
@@ -280,7 +413,8 @@ void SetStatusMessage(edit::editorConfig &E)
 
 void SetStatusMessage(edit::editorConfig &E, const char *msg)
 {
-  strncpy(E.statusmsg, msg, sizeof(E.statusmsg));
+  strncpy(E.statusmsg, msg, sizeof(E.statusmsg) - 1);
+  E.statusmsg[sizeof(E.statusmsg) - 1] = '\0';
   E.statusmsg_time = time(NULL);
 }
 
@@ -290,7 +424,8 @@ char *Prompt(edit::editorConfig &E,
   const Terminal &term,
   const char *prompt1,
   const char *prompt2,
-  void (*callback)(edit::editorConfig &, char *, int))
+  void (*callback)(edit::editorConfig &, char *, int),
+  bool empty)
 {
   std::size_t bufsize = 128;
   char *buf = static_cast<char *>(malloc(bufsize));
@@ -305,10 +440,11 @@ char *Prompt(edit::editorConfig &E,
   while (true) {
     snprintf(outbuf, sizeof(outbuf), "%s%s%s", prompt1, buf, prompt2);
     SetStatusMessage(E, outbuf);
-    RefreshScreen(E, ab);
-    term.write(ab);
+    Present(E, ab);
 
     int c = term.read_key();
+    // A terminal that hung up cancels the prompt
+    if (term.input_closed()) c = Key::ESC;
     if (c == Key::DEL || c == CTRL_KEY('h') || c == Key::BACKSPACE) {
       if (buflen != 0) buf[--buflen] = '\0';
     } else if (c == Key::ESC) {
@@ -317,7 +453,7 @@ char *Prompt(edit::editorConfig &E,
       free(buf);
       return nullptr;
     } else if (c == Key::ENTER) {
-      if (buflen != 0) {
+      if (buflen != 0 || empty) {
         SetStatusMessage(E);
         if (callback) callback(E, buf, c);
         return buf;
@@ -337,19 +473,20 @@ char *Prompt(edit::editorConfig &E,
 
 void MoveCursor(edit::editorConfig &E, int key)
 {
+  const auto &rows = E.row;
   switch (key) {
   case Key::ARROW_LEFT:
     if (E.cx != 0) {
       E.cx--;
     } else if (E.cy > 0) {
       E.cy--;
-      E.cx = E.row[E.cy].size;
+      E.cx = rows[E.cy].size;
     }
     break;
   case Key::ARROW_RIGHT:
-    if ((E.cy < E.numrows) && E.cx < E.row[E.cy].size) {
+    if ((E.cy < E.numrows) && E.cx < rows[E.cy].size) {
       E.cx++;
-    } else if ((E.cy < E.numrows) && E.cx == E.row[E.cy].size) {
+    } else if ((E.cy < E.numrows) && E.cx == rows[E.cy].size) {
       E.cy++;
       E.cx = 0;
     }
@@ -362,7 +499,7 @@ void MoveCursor(edit::editorConfig &E, int key)
     break;
   }
 
-  int rowlen = (E.cy < E.numrows) ? static_cast<int>(E.row[E.cy].size) : 0;
+  int rowlen = (E.cy < E.numrows) ? static_cast<int>(rows[E.cy].size) : 0;
   if (static_cast<int>(E.cx) > rowlen) { E.cx = static_cast<std::size_t>(rowlen); }
 }
 
@@ -371,6 +508,8 @@ bool ProcessKeypress(edit::editorConfig &E, const Terminal &term)
   static int quit_times = edit::KILO_QUIT_TIMES;
 
   int c = term.read_key();
+  // The terminal is gone, and with it whoever could have answered a prompt
+  if (term.input_closed()) return false;
 
   switch (c) {
   case Key::ENTER:
@@ -401,13 +540,26 @@ bool ProcessKeypress(edit::editorConfig &E, const Terminal &term)
     break;
 
   case Key::END:
-    if (E.cy < E.numrows) E.cx = E.row[E.cy].size;
+    if (E.cy < E.numrows) E.cx = std::as_const(E.row)[E.cy].size;
     break;
 
   case CTRL_KEY('f'):
     Find(E, term);
     break;
 
+  case CTRL_KEY('r'):
+    Replace(E, term);
+    break;
+
+  // Ctrl-Z is left to the terminal, which suspends the editor with it
+  case CTRL_KEY('u'):
+    if (!edit::Undo(E)) SetStatusMessage(E, "Nothing to undo");
+    break;
+
+  case CTRL_KEY('y'):
+    if (!edit::Redo(E)) SetStatusMessage(E, "Nothing to redo");
+    break;
+
   case Key::BACKSPACE:
   case CTRL_KEY('h'):
   case Key::DEL:
@@ -435,6 +587,9 @@ bool ProcessKeypress(edit::editorConfig &E, const Terminal &term)
     break;
 
   case CTRL_KEY('l'):
+    Repaint();
+    break;
+
   case Key::ESC:
     break;
 
@@ -442,6 +597,10 @@ bool ProcessKeypress(edit::editorConfig &E, const Terminal &term)
     edit::InsertChar('\t');
     break;
 
+  case Key::PASTE:
+    edit::InsertText(E, term.paste());
+    break;
+
   default:
     edit::InsertChar(static_cast<char>(c));
     break;
@@ -453,20 +612,28 @@ bool ProcessKeypress(edit::editorConfig &E, const Terminal &term)
 
 // /*** init ***/
 
-void init(edit::editorConfig &E, const Terminal &term)
+void Resize(edit::editorConfig &E, const Terminal &term)
 {
+  term.get_term_size(E.screenrows, E.screencols);
+  E.screenrows -= 2;
+}
+
+void init(edit::editorConfig &E, const Terminal &term, output::writer &w)
+{
+  in = &term;
+  out = &w;
   E.cx = 0;
   E.cy = 0;
   E.rx = 0;
   E.rowoff = 0;
   E.coloff = 0;
   E.numrows = 0;
+  E.hl_valid = 0;
   E.dirty = 0;
   E.statusmsg[0] = '\0';
   E.statusmsg_time = 0;
   E.syntax = nullptr;
-  term.get_term_size(E.screenrows, E.screencols);
-  E.screenrows -= 2;
+  Resize(E, term);
 }
 
 }// end namespace tui
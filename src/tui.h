@@ -1,28 +1,53 @@
 #pragma once
 
 #include "edit.h"
+#include "output.h"
+#include "screen.h"
 #include "terminal.h"
 #include <string>
 
 namespace tui {
 
+// Starts saving the buffer in the background; see Background()
 void Save(edit::editorConfig &, const Term::Terminal &term);
+// Reports a save that has ended. Returns true while work is still going on
+// in the background: a save, or the indexing of a large file.
+bool Background(edit::editorConfig &);
+// Lets a save that is still running finish
+void Wait(edit::editorConfig &);
 void Find(edit::editorConfig &, const Term::Terminal &term);
+// Prompts for a query, as Find() does, and for its replacement, and replaces
+// every match at once
+void Replace(edit::editorConfig &, const Term::Terminal &term);
 
-void DrawRows(edit::editorConfig &, std::string &);
-void DrawStatusBar(edit::editorConfig &, std::string &);
-void DrawMessageBar(edit::editorConfig &, std::string &);
+void DrawRows(edit::editorConfig &, screen::frame &);
+void DrawStatusBar(edit::editorConfig &, screen::frame &);
+void DrawMessageBar(edit::editorConfig &, screen::frame &);
 void RefreshScreen(edit::editorConfig &, std::string &);
+// Draws the screen and hands it to the writer. While the terminal is still
+// taking the previous frame and a key is already waiting, the frame is
+// skipped: the next refresh will show the newer state instead. The event
+// loop doesn't call it while the writer is busy, but finishes the frame when
+// stdout can be written to and draws the newest state after.
+void Present(edit::editorConfig &, std::string &);
+// Makes the next refresh redraw the whole screen
+void Repaint();
 void SetStatusMessage(edit::editorConfig &);
 void SetStatusMessage(edit::editorConfig &, const char *msg);
 
+// Asks for a line of text in the message bar. Returns it, to be freed by the
+// caller, or nullptr if ESC cancelled the prompt. ENTER only takes an empty
+// reply if 'empty' says it is one.
 char *Prompt(edit::editorConfig &,
   const Term::Terminal &term,
   const char *prompt1,
   const char *prompt2,
-  void (*callback)(edit::editorConfig &, char *, int));
+  void (*callback)(edit::editorConfig &, char *, int),
+  bool empty = false);
 void MoveCursor(edit::editorConfig &, int key);
 bool ProcessKeypress(edit::editorConfig &, const Term::Terminal &term);
-void init(edit::editorConfig &, const Term::Terminal &term);
+// Fits the editor to the current size of the terminal
+void Resize(edit::editorConfig &, const Term::Terminal &term);
+void init(edit::editorConfig &, const Term::Terminal &term, output::writer &out);
 
 }// end namespace tui
@@ -0,0 +1,169 @@
+#include "undo.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+namespace undo {
+
+history::history(std::size_t l) : limit(l) {}
+
+void history::begin()
+{
+  fresh = true;
+  dropping = false;
+}
+
+void history::add(op kind, std::size_t row, std::size_t col, std::string_view text)
+{
+  if (dropping) return;
+  if (text.size() > std::numeric_limits<std::uint32_t>::max() || text.size() > limit) {
+    // Too large to keep: the history before it could not be replayed
+    // without it either
+    clear();
+    dropping = true;
+    return;
+  }
+  if (done < records.size()) {
+    truncate(records[done].offset);
+    records.resize(done);
+  }
+  bool first = fresh;
+  fresh = false;
+  records.push_back(record{ row, col, append(text), static_cast<std::uint32_t>(text.size()), kind, first, false });
+  done = records.size();
+  evict();
+}
+
+void history::type(std::size_t row, std::size_t col, char c)
+{
+  if (!fresh && !dropping && done == records.size() && !records.empty()) {
+    auto &r = records.back();
+    // A character after a blank starts the next word, and the next group
+    auto word = [&] { return c != ' ' && c != '\t' && (lastByte() == ' ' || lastByte() == '\t'); };
+    if (r.typed && r.row == row && r.col + r.length == col && r.offset + r.length == end && !word()
+        && r.length < std::numeric_limits<std::uint32_t>::max()) {
+      append(std::string_view(&c, 1));
+      r.length++;
+      evict();
+      return;
+    }
+    // Typing into a row just added goes in the group that added it
+    if (!(r.kind == op::insertRow && r.row == row)) begin();
+  } else {
+    begin();
+  }
+  add(op::insertText, row, col, std::string_view(&c, 1));
+  if (!dropping) records.back().typed = true;
+}
+
+std::vector<record> history::undo()
+{
+  if (done == 0) return {};
+  auto start = done - 1;
+  while (start > 0 && !records[start].first) start--;
+  std::vector<record> group(records.begin() + static_cast<std::ptrdiff_t>(start),
+    records.begin() + static_cast<std::ptrdiff_t>(done));
+  done = start;
+  fresh = true;
+  return group;
+}
+
+std::vector<record> history::redo()
+{
+  if (done == records.size()) return {};
+  auto stop = done + 1;
+  while (stop < records.size() && !records[stop].first) stop++;
+  std::vector<record> group(records.begin() + static_cast<std::ptrdiff_t>(done),
+    records.begin() + static_cast<std::ptrdiff_t>(stop));
+  done = stop;
+  fresh = true;
+  return group;
+}
+
+std::string history::text(const record &r) const
+{
+  std::string out(r.length, '\0');
+  std::size_t copied = 0;
+  while (copied < out.size()) {
+    auto at = r.offset + copied - base;
+    auto in = static_cast<std::size_t>(at % BLOCK);
+    auto n = std::min(BLOCK - in, out.size() - copied);
+    memcpy(out.data() + copied, blocks[static_cast<std::size_t>(at / BLOCK)].get() + in, n);
+    copied += n;
+  }
+  return out;
+}
+
+void history::clear()
+{
+  records.clear();
+  done = 0;
+  blocks.clear();
+  base = end;
+  fresh = true;
+  dropping = false;
+}
+
+std::size_t history::memory() const { return records.size() * sizeof(record) + blocks.size() * BLOCK; }
+
+std::uint64_t history::append(std::string_view text)
+{
+  auto at = end;
+  std::size_t copied = 0;
+  while (copied < text.size()) {
+    auto used = end - base;
+    auto in = static_cast<std::size_t>(used % BLOCK);
+    if (used / BLOCK == blocks.size()) blocks.push_back(std::make_unique<char[]>(BLOCK));
+    auto n = std::min(BLOCK - in, text.size() - copied);
+    memcpy(blocks[static_cast<std::size_t>(used / BLOCK)].get() + in, text.data() + copied, n);
+    copied += n;
+    end += n;
+  }
+  return at;
+}
+
+// Drops the text from offset 'to' on, and the blocks only it used
+void history::truncate(std::uint64_t to)
+{
+  end = to;
+  auto needed = static_cast<std::size_t>((end - base + BLOCK - 1) / BLOCK);
+  while (blocks.size() > needed) blocks.pop_back();
+}
+
+char history::lastByte() const
+{
+  auto at = end - 1 - base;
+  return blocks[static_cast<std::size_t>(at / BLOCK)][static_cast<std::size_t>(at % BLOCK)];
+}
+
+void history::evict()
+{
+  // Counts the text the records use, not the blocks, which are only freed
+  // once the records are gone
+  auto used = [&] {
+    auto text = records.empty() ? 0 : end - records.front().offset;
+    return records.size() * sizeof(record) + static_cast<std::size_t>(text);
+  };
+  while (used() > limit && !records.empty()) {
+    std::size_t n = 1;
+    while (n < records.size() && !records[n].first) n++;
+    if (n == records.size()) {
+      // Only the group being added is left, and it cannot be kept whole
+      clear();
+      dropping = true;
+      return;
+    }
+    records.erase(records.begin(), records.begin() + static_cast<std::ptrdiff_t>(n));
+    done -= std::min(done, n);
+  }
+
+  // Free the blocks before the oldest text still kept
+  auto keep = records.empty() ? end : records.front().offset;
+  while (!blocks.empty() && base + BLOCK <= keep) {
+    blocks.pop_front();
+    base += BLOCK;
+  }
+}
+
+}// end namespace undo
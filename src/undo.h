@@ -0,0 +1,88 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace undo {
+
+// Bytes of history kept by default before the oldest edits are forgotten
+const std::size_t KILO_UNDO_LIMIT{ 64 << 20 };
+
+enum class op : std::uint8_t {
+  insertRow,// a row was inserted at 'row' with the text
+  insertText,// text was inserted at 'row', 'col'; '\n' in it splits rows
+  deleteText,// text was deleted from 'row', 'col'; '\n' in it joined rows
+};
+
+// One edit. The text is kept in the history's byte log, not in the record.
+struct record
+{
+  std::size_t row;
+  std::size_t col;
+  std::uint64_t offset;// of the text in the byte log
+  std::uint32_t length;
+  op kind;
+  bool first;// the first record of a group, undone and redone as one
+  bool typed;// made by history::type(), which may add to it
+};
+
+// The edits made to a buffer, as records appended to a list and their text
+// appended to a log of fixed-size blocks. Undoing moves a point back over
+// the records of a group and redoing moves it forward again; a new edit
+// drops whatever could still be redone.
+//
+// Typing a character right after the one typed before adds it to the
+// record of that one, up to the end of a word, instead of making a record
+// per keystroke. Once records and text take more than the limit, the oldest
+// groups are dropped, and the blocks of text only they used are freed.
+class history
+{
+public:
+  explicit history(std::size_t limit = KILO_UNDO_LIMIT);
+
+  // The records added until the next begin() form one group
+  void begin();
+  void add(op kind, std::size_t row, std::size_t col, std::string_view text);
+  // Records c typed at row, col, merging it into the record before if that
+  // was typing that ended there. Starts a group of its own otherwise, unless
+  // the record before added that row.
+  void type(std::size_t row, std::size_t col, char c);
+
+  // Moves the undo point back over the last group done and returns its
+  // records, in the order they were added; empty if there is none
+  std::vector<record> undo();
+  // Moves the undo point forward over the next group undone and returns its
+  // records, in the order they were added; empty if there is none
+  std::vector<record> redo();
+  std::string text(const record &) const;
+
+  void clear();
+  std::size_t size() const { return records.size(); }
+  // Bytes taken by records and text
+  std::size_t memory() const;
+
+private:
+  static constexpr std::size_t BLOCK{ 64 << 10 };
+
+  std::uint64_t append(std::string_view text);
+  void truncate(std::uint64_t to);
+  char lastByte() const;
+  void evict();
+
+  std::size_t limit;
+  std::deque<record> records{};
+  std::size_t done{};// records before this one are applied
+  bool fresh{ true };// the next record starts a group
+  bool dropping{ false };// the group being added outgrew the limit
+
+  std::deque<std::unique_ptr<char[]>> blocks{};
+  std::uint64_t base{};// offset of the first byte of blocks.front()
+  std::uint64_t end{};// offset just past the last byte appended
+};
+
+}// end namespace undo
@@ -0,0 +1,254 @@
+#include "buffer.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+edit::erow makeRow(const std::string &s)
+{
+  edit::erow r{};
+  r.chars = s;
+  r.size = s.length();
+  return r;
+}
+
+bool sameRows(const edit::rowBuffer &b, const std::vector<std::string> &ref)
+{
+  if (b.size() != ref.size()) return false;
+  for (std::size_t i = 0; i < ref.size(); i++) {
+    if (b[i].chars != ref[i]) return false;
+  }
+  return true;
+}
+
+}// namespace
+
+TEST_CASE("Insert across chunks", "[buffer]")
+{
+  edit::rowBuffer b;
+  std::vector<std::string> ref;
+
+  // Appends, then inserts at the front, then into the middle, enough to
+  // split chunks several times over.
+  for (int i = 0; i < 2000; i++) {
+    b.insert(b.size(), makeRow("a" + std::to_string(i)));
+    ref.push_back("a" + std::to_string(i));
+  }
+  for (int i = 0; i < 1000; i++) {
+    b.insert(0, makeRow("b" + std::to_string(i)));
+    ref.insert(ref.begin(), "b" + std::to_string(i));
+  }
+  for (int i = 0; i < 1000; i++) {
+    auto at = (static_cast<std::size_t>(i) * 7919) % ref.size();
+    auto &r = b.insert(at, makeRow("c" + std::to_string(i)));
+    CHECK(r.chars == "c" + std::to_string(i));
+    ref.insert(ref.begin() + static_cast<std::ptrdiff_t>(at), "c" + std::to_string(i));
+  }
+  CHECK(sameRows(b, ref));
+}
+
+TEST_CASE("Erase across chunks", "[buffer]")
+{
+  edit::rowBuffer b;
+  std::vector<std::string> ref;
+  for (int i = 0; i < 3000; i++) {
+    b.insert(b.size(), makeRow(std::to_string(i)));
+    ref.push_back(std::to_string(i));
+  }
+
+  for (int i = 0; i < 2500; i++) {
+    auto at = (static_cast<std::size_t>(i) * 104729) % ref.size();
+    b.erase(at);
+    ref.erase(ref.begin() + static_cast<std::ptrdiff_t>(at));
+  }
+  CHECK(sameRows(b, ref));
+
+  // Out of range erase is ignored
+  b.erase(b.size());
+  CHECK(sameRows(b, ref));
+
+  while (!b.empty()) b.erase(0);
+  CHECK(b.size() == 0);
+
+  b.insert(0, makeRow("again"));
+  CHECK(b[0].chars == "again");
+}
+
+TEST_CASE("Lazy rows from a mapped file", "[buffer]")
+{
+  auto path = std::filesystem::temp_directory_path() / "kilo_test_buffer.txt";
+  {
+    std::ofstream out(path, std::ios::binary);
+    for (int i = 0; i < 5000; i++) out << "line " << i << (i % 2 ? "\r\n" : "\n");
+    out << "last";
+  }
+
+  auto file = std::make_shared<const edit::mappedFile>(path.c_str());
+  file->wait(5001);
+  CHECK(file->indexed());
+  CHECK(file->lines() == 5001);
+
+  edit::rowBuffer b;
+  b.attach(file);
+  CHECK(b.adopt() == 5001);
+  CHECK(b.size() == 5001);
+  CHECK(!b.indexing());
+  CHECK(!b.loaded(4000));
+
+  CHECK(b[1].chars == "line 1");
+  CHECK(b[5000].chars == "last");
+  CHECK(b.loaded(1));
+  CHECK(!b.loaded(4000));
+
+  // Dropping the first and last line doesn't read anything
+  b.erase(4999);
+  b.erase(2000);
+  CHECK(b[2000].chars == "line 2001");
+  CHECK(b.size() == 4999);
+
+  b.insert(3000, makeRow("new"));
+  CHECK(b[2999].chars == "line 3000");
+  CHECK(b[3000].chars == "new");
+  CHECK(b[3001].chars == "line 3001");
+
+  std::filesystem::remove(path);
+}
+
+TEST_CASE("Snapshots are not changed by later edits", "[buffer]")
+{
+  edit::rowBuffer b;
+  std::vector<std::string> ref;
+  for (int i = 0; i < 2000; i++) {
+    b.insert(b.size(), makeRow("r" + std::to_string(i)));
+    ref.push_back("r" + std::to_string(i));
+  }
+  const edit::hlSpan spans[] = { { 0, 2, 3 } };
+  b[10].highlight(spans);
+
+  auto snap = b.snapshot();
+  b[10].chars = "changed";
+  b[10].highlight({});
+  b.erase(700);
+  b.insert(1500, makeRow("new"));
+  for (int i = 0; i < 600; i++) b.erase(0);
+
+  std::vector<std::string> seen;
+  snap.forEach([&](std::string_view line) { seen.emplace_back(line); });
+  CHECK(snap.size() == ref.size());
+  CHECK(seen == ref);
+
+  // The buffer itself has the edits
+  auto again = b.snapshot();
+  CHECK(again.size() == b.size());
+  CHECK(b[0].chars == "r600");
+}
+
+TEST_CASE("Rows keep their highlighting as runs", "[buffer]")
+{
+  auto r = makeRow("int x = 42; // answer");
+  r.rsize = r.size;
+  CHECK(r.highlight().empty());
+  CHECK(r.highlightAt(0) == 0);
+
+  const edit::hlSpan spans[] = { { 0, 3, 4 }, { 8, 2, 6 }, { 12, 9, 1 } };
+  r.highlight(spans);
+  CHECK(r.hl_count == 3);
+  CHECK(r.highlightAt(0) == 4);
+  CHECK(r.highlightAt(2) == 4);
+  CHECK(r.highlightAt(3) == 0);
+  CHECK(r.highlightAt(9) == 6);
+  CHECK(r.highlightAt(11) == 0);
+  CHECK(r.highlightAt(20) == 1);
+  CHECK(r.highlightAt(21) == 0);
+
+  // Copies have highlighting of their own
+  edit::erow copy(r);
+  const edit::hlSpan fewer[] = { { 1, 1, 5 } };
+  r.highlight(fewer);
+  CHECK(copy.hl_count == 3);
+  CHECK(copy.highlightAt(9) == 6);
+  CHECK(r.highlightAt(9) == 0);
+
+  edit::erow moved(std::move(copy));
+  CHECK(moved.hl_count == 3);
+  CHECK(copy.hl == nullptr);
+}
+
+TEST_CASE("Row memory goes back to the system as slabs empty", "[buffer]")
+{
+  auto &arena = edit::RowArena();
+  arena.trim();
+  auto before = arena.slabs();
+
+  std::vector<void *> blocks;
+  for (int i = 0; i < 100000; i++) blocks.push_back(arena.allocate(504));
+  CHECK(arena.slabs() > before + 100);
+  for (auto *p : blocks) arena.deallocate(p, 504);
+  // One slab of the class is kept for the next row
+  CHECK(arena.slabs() <= before + 1);
+}
+
+TEST_CASE("Row memory freed on another thread goes back to its arena", "[buffer]")
+{
+  std::vector<void *> blocks;
+  std::size_t before = 0;
+  std::thread([&] {
+    auto &arena = edit::RowArena();
+    arena.trim();
+    before = arena.slabs();
+    for (int i = 0; i < 100000; i++) blocks.push_back(arena.allocate(496));
+  }).join();
+
+  // The thread is gone; its arena takes the blocks back all the same
+  for (auto *p : blocks) edit::RowArena().deallocate(p, 496);
+
+  // and hands them, with the arena, to the next thread
+  std::size_t after = SIZE_MAX;
+  std::thread([&] {
+    auto &arena = edit::RowArena();
+    arena.trim();
+    after = arena.slabs();
+  }).join();
+  CHECK(after == before);
+}
+
+namespace {
+
+// Frees its rows, and makes one more, after the thread gave its arena up
+struct lateRows
+{
+  std::vector<edit::rowString> rows{};
+  ~lateRows()
+  {
+    rows.clear();
+    edit::rowString late(100, 'x');
+  }
+};
+
+}// namespace
+
+TEST_CASE("Rows freed by the destructor of a thread_local go back to the arena", "[buffer]")
+{
+  std::size_t before = 0;
+  std::thread([&] {
+    // Made before the arena is, so it is destroyed after the arena is given up
+    thread_local lateRows late;
+    auto &arena = edit::RowArena();
+    arena.trim();
+    before = arena.slabs();
+    for (int i = 0; i < 100000; i++) late.rows.emplace_back(490, 'x');
+  }).join();
+
+  std::size_t after = SIZE_MAX;
+  std::thread([&] {
+    auto &arena = edit::RowArena();
+    arena.trim();
+    after = arena.slabs();
+  }).join();
+  CHECK(after == before);
+}
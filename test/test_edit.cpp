@@ -1,9 +1,20 @@
 #include "edit.h"
 #include "row.h"
+#include "search.h"
 #include <array>
+#include <chrono>
 #include <catch2/catch_test_macros.hpp>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
 #include <string>
+#include <system_error>
+#include <thread>
+
+#include <sys/stat.h>
+#include <unistd.h>
 
 TEST_CASE("Insert", "[edit]")
 {
@@ -15,41 +26,33 @@ TEST_CASE("Insert", "[edit]")
   edit::Insert(E, 0, "Hello");
   CHECK(E.row[0].chars == "Hello");
   CHECK(E.row[0].size == 5);
-  CHECK(E.row[0].idx == 0);
   CHECK(E.numrows == 1);
   CHECK(E.dirty > 0);
 
   // Second Entry, following first
   edit::Insert(E, 1, "World");
   CHECK(E.row[1].chars == "World");
-  CHECK(E.row[1].idx == 1);
   CHECK(E.numrows == 2);
 
   // Third Entry, before first
   edit::Insert(E, 0, "Top");
   CHECK(E.row[0].chars == "Top");
-  CHECK(E.row[0].idx == 0);
   CHECK(E.row[1].chars == "Hello");
-  CHECK(E.row[1].idx == 1);
   CHECK(E.row[2].chars == "World");
-  CHECK(E.row[2].idx == 2);
   CHECK(E.numrows == 3);
 
   // Fourth Entry, after last
   edit::Insert(E, 3, "Bottom");
   CHECK(E.row[3].chars == "Bottom");
-  CHECK(E.row[3].idx == 3);
   CHECK(E.row[2].chars == "World");
-  CHECK(E.row[2].idx == 2);
   CHECK(E.numrows == 4);
 
   // Fifth Entry, in the middle
   edit::Insert(E, 2, "Middle");
   CHECK(E.row[2].chars == "Middle");
-  CHECK(E.row[2].idx == 2);
   CHECK(E.row[4].chars == "Bottom");
-  CHECK(E.row[4].idx == 4);
   CHECK(E.numrows == 5);
+  CHECK(E.row.size() == 5);
 }
 
 TEST_CASE("Del", "[edit]")
@@ -67,9 +70,7 @@ TEST_CASE("Del", "[edit]")
   // Delete middle  ("Two")
   edit::Del(E, 1);
   CHECK(E.row[1].chars == "Three");
-  CHECK(E.row[1].idx == 1);
   CHECK(E.row[2].chars == "Four");
-  CHECK(E.row[2].idx == 2);
   CHECK(E.numrows == 3);
   CHECK(E.dirty > 0);
 
@@ -77,16 +78,361 @@ TEST_CASE("Del", "[edit]")
   // Delete last ("Four")
   edit::Del(E, 2);
   CHECK(E.row[1].chars == "Three");
-  CHECK(E.row[1].idx == 1);
   CHECK(E.numrows == 2);
 
   // Delete first ("One")
   edit::Del(E, 0);
   CHECK(E.row[0].chars == "Three");
-  CHECK(E.row[0].idx == 0);
   CHECK(E.numrows == 1);
 
   // Delete last remaining
   edit::Del(E, 0);
   CHECK(E.numrows == 0);
+  CHECK(E.row.empty());
+}
+
+TEST_CASE("InsertText", "[edit]")
+{
+  edit::editorConfig E{};
+
+  edit::Insert(E, 0, "Hello World");
+  E.cx = 6;
+
+  // Text without line breaks stays on the row
+  edit::InsertText(E, "big ");
+  CHECK(E.row[0].chars == "Hello big World");
+  CHECK(E.cx == 10);
+  CHECK(E.numrows == 1);
+
+  // Line breaks of any kind split the text into rows
+  edit::InsertText(E, "one\r\ntwo\rthree\nfour ");
+  CHECK(E.numrows == 4);
+  CHECK(E.row[0].chars == "Hello big one");
+  CHECK(E.row[1].chars == "two");
+  CHECK(E.row[2].chars == "three");
+  CHECK(E.row[3].chars == "four World");
+  CHECK(E.row[3].size == 10);
+  CHECK(E.cy == 3);
+  CHECK(E.cx == 5);
+
+  // A trailing line break leaves the cursor at the start of a new row
+  E.cx = 0;
+  edit::InsertText(E, "last\n");
+  CHECK(E.numrows == 5);
+  CHECK(E.row[3].chars == "last");
+  CHECK(E.row[4].chars == "four World");
+  CHECK(E.cy == 4);
+  CHECK(E.cx == 0);
+}
+
+TEST_CASE("Save", "[edit]")
+{
+  auto dir = std::filesystem::temp_directory_path() / "kilo_test_save";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directory(dir);
+  auto path = dir / "out.txt";
+
+  // Most rows stay unread in the mapped file; a few are edited
+  {
+    std::ofstream out(path, std::ios::binary);
+    for (int i = 0; i < 3000; i++) out << "line " << i << "\r\n";
+  }
+  std::filesystem::permissions(path, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write);
+
+  edit::editorConfig E{};
+  E.filename = path.string();
+  E.row.attach(std::make_shared<const edit::mappedFile>(path.c_str()));
+  E.row.wait();
+  edit::Poll(E);
+  REQUIRE(E.numrows == 3000);
+  edit::Insert(E, 1000, "inserted");
+  edit::Del(E, 2000);
+  CHECK(!E.row.loaded(2500));
+
+  auto written = edit::Save(E);
+  CHECK(E.dirty == 0);
+  CHECK(!E.row.loaded(2500));
+
+  std::ifstream in(path, std::ios::binary);
+  std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  CHECK(saved.size() == written);
+  std::string expected;
+  for (int i = 0; i < 3000; i++) {
+    if (i == 1000) expected += "inserted\n";
+    if (i != 1999) expected += "line " + std::to_string(i) + "\n";
+  }
+  CHECK(saved == expected);
+  CHECK(std::filesystem::status(path).permissions()
+        == (std::filesystem::perms::owner_read | std::filesystem::perms::owner_write));
+
+  // A failed save throws and leaves nothing behind
+  E.filename = (dir / "missing" / "out.txt").string();
+  CHECK_THROWS_AS(edit::Save(E), std::system_error);
+  CHECK(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 1);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Save keeps the file where and whose it is", "[edit]")
+{
+  auto dir = std::filesystem::temp_directory_path() / "kilo_test_save_place";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directory(dir);
+  auto slurp = [](const std::filesystem::path &p) {
+    std::ifstream in(p, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  };
+
+  edit::editorConfig E{};
+  edit::Insert(E, 0, "one");
+  edit::Insert(E, 1, "two");
+
+  // Saving through a symlink replaces the file it points to
+  auto target = dir / "target.txt";
+  auto link = dir / "link.txt";
+  std::ofstream(target) << "old\n";
+  std::filesystem::create_symlink(target.filename(), link);
+  if (geteuid() == 0) CHECK(chown(target.c_str(), 4242, 4343) == 0);
+  E.filename = link.string();
+  CHECK(edit::Save(E) == 8);
+  CHECK(std::filesystem::is_symlink(link));
+  CHECK(slurp(target) == "one\ntwo\n");
+
+  // and keeps its owner, where we may set it
+  struct stat st;
+  REQUIRE(stat(target.c_str(), &st) == 0);
+  if (geteuid() == 0) {
+    CHECK(st.st_uid == 4242);
+    CHECK(st.st_gid == 4343);
+  }
+
+  // A file whose name leaves no room for a temporary one next to it is
+  // written in place
+  auto longName = dir / std::string(252, 'n');
+  std::ofstream(longName) << "a much longer old text\n";
+  E.filename = longName.string();
+  CHECK(edit::Save(E) == 8);
+  CHECK(slurp(longName) == "one\ntwo\n");
+  CHECK(std::distance(std::filesystem::directory_iterator(dir), std::filesystem::directory_iterator()) == 3);
+
+  // but not while rows are still read from it
+  auto mappedName = dir / std::string(252, 'm');
+  {
+    std::ofstream out(mappedName, std::ios::binary);
+    for (int i = 0; i < 3000; i++) out << "line " << i << "\n";
+  }
+  auto before = slurp(mappedName);
+  edit::editorConfig M{};
+  M.filename = mappedName.string();
+  M.row.attach(std::make_shared<const edit::mappedFile>(mappedName.c_str()));
+  M.row.wait();
+  edit::Poll(M);
+  edit::Insert(M, 0, "new");
+  REQUIRE(!M.row.loaded(2500));
+  CHECK_THROWS_AS(edit::Save(M), std::system_error);
+  CHECK(slurp(mappedName) == before);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("Save in the background", "[edit]")
+{
+  auto dir = std::filesystem::temp_directory_path() / "kilo_test_save_job";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directory(dir);
+  auto path = dir / "out.txt";
+
+  edit::editorConfig E{};
+  E.filename = path.string();
+  for (int i = 0; i < 5000; i++) edit::Insert(E, static_cast<int>(E.numrows), "row " + std::to_string(i));
+  E.dirty = 5;
+
+  // Edits made while saving are neither in the file nor forgotten
+  edit::saveJob job(E);
+  CHECK(job.lines() == 5000);
+  E.row[0].chars = "edited";
+  edit::Del(E, 4999);
+  auto written = job.finish(E);
+  CHECK(job.linesWritten() == 5000);
+  CHECK(E.dirty == 1);
+
+  std::ifstream in(path, std::ios::binary);
+  std::string saved((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+  CHECK(saved.size() == written);
+  std::string expected;
+  for (int i = 0; i < 5000; i++) expected += "row " + std::to_string(i) + "\n";
+  CHECK(saved == expected);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("A save started while the file is indexed waits for it without blocking", "[edit]")
+{
+  auto dir = std::filesystem::temp_directory_path() / "kilo_test_save_indexing";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directory(dir);
+  auto path = dir / "in.txt";
+  std::string text;
+  for (int i = 0; i < 2000000; i++) text += "line " + std::to_string(i) + "\n";
+  std::ofstream(path, std::ios::binary) << text;
+
+  edit::editorConfig E{};
+  E.filename = (dir / "out.txt").string();
+  E.row.attach(std::make_shared<const edit::mappedFile>(path.c_str()));
+  edit::saveJob job(E);
+  // Nothing is written before every line is known
+  if (E.row.indexing()) CHECK(job.lines() == 0);
+  while (!job.done(E)) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  CHECK(job.lines() == 2000000);
+  CHECK(job.finish(E) == text.size());
+
+  std::ifstream in(E.filename, std::ios::binary);
+  CHECK(std::string((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>()) == text);
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("ReplaceAll", "[edit]")
+{
+  edit::editorConfig E{};
+  for (auto text : { "foo bar foo", "nothing", "foofoo", "aaa" }) edit::Insert(E, static_cast<int>(E.numrows), text);
+  E.dirty = 0;
+
+  search::matchIndex index;
+  index.update(E.row, "foo");
+  CHECK(edit::ReplaceAll(E, index.matches(), "quux") == 4);
+  CHECK(E.row[0].chars == "quux bar quux");
+  CHECK(E.row[0].rsize == 13);
+  CHECK(E.row[1].chars == "nothing");
+  CHECK(E.row[2].chars == "quuxquux");
+  CHECK(E.row[2].size == 8);
+  CHECK(E.dirty == 1);
+
+  // Overlapping matches are replaced once
+  index.update(E.row, "aa");
+  REQUIRE(index.matches().size() == 2);
+  CHECK(edit::ReplaceAll(E, index.matches(), "b") == 1);
+  CHECK(E.row[3].chars == "ba");
+
+  // Regex matches have lengths of their own
+  index.update(E.row, "q[a-z]*x", true);
+  CHECK(edit::ReplaceAll(E, index.matches(), "x") == 3);
+  CHECK(E.row[0].chars == "x bar x");
+  CHECK(E.row[2].chars == "x");
+  CHECK(edit::ReplaceAll(E, {}, "x") == 0);
+  CHECK(E.dirty == 3);
+
+  // Replacing with nothing deletes the matches
+  index.update(E.row, "x");
+  CHECK(edit::ReplaceAll(E, index.matches(), "") == 3);
+  CHECK(E.row[0].chars == " bar ");
+  CHECK(E.row[0].rsize == 5);
+  CHECK(E.row[2].chars.empty());
+  CHECK(E.row[2].size == 0);
+  CHECK(E.dirty == 4);
+}
+
+TEST_CASE("ReplaceAll a million matches", "[edit]")
+{
+  edit::editorConfig E{};
+  for (int i = 0; i < 100000; i++) edit::Insert(E, static_cast<int>(E.numrows), "x=1 x=2 x=3 x=4 x=5 x=6 x=7 x=8 x=9 x=0");
+
+  search::matchIndex index;
+  index.update(E.row, "x=", false);
+  REQUIRE(index.wait(std::chrono::seconds(30)));
+  REQUIRE(index.matches().size() == 1000000);
+  CHECK(edit::ReplaceAll(E, index.matches(), "value = ") == 1000000);
+  CHECK(E.row[99999].chars == "value = 1 value = 2 value = 3 value = 4 value = 5 value = 6 value = 7 value = 8 value = 9 value = 0");
+  CHECK(E.row[99999].rsize == E.row[99999].size);
+}
+
+TEST_CASE("Undo and Redo", "[edit]")
+{
+  auto &E = edit::referenceToE();
+  E.row.clear();
+  E.numrows = 0;
+  E.cx = E.cy = 0;
+  E.hl_valid = 0;
+  E.history.clear();
+
+  // Typing past the last row adds one, and is undone with it
+  for (char c : std::string("int x")) edit::InsertChar(c);
+  edit::InsertNewLine();
+  for (char c : std::string("y")) edit::InsertChar(c);
+  REQUIRE(E.numrows == 2);
+  CHECK(E.row[0].chars == "int x");
+  CHECK(E.row[1].chars == "y");
+
+  CHECK(edit::Undo(E));
+  CHECK(E.numrows == 2);
+  CHECK(E.row[1].chars == "");
+  CHECK(edit::Undo(E));
+  CHECK(E.numrows == 1);
+  CHECK(E.cy == 0);
+  CHECK(E.cx == 5);
+  // "int " and "x" are words of their own
+  CHECK(edit::Undo(E));
+  CHECK(E.row[0].chars == "int ");
+  CHECK(edit::Undo(E));
+  CHECK(E.numrows == 0);
+  CHECK_FALSE(edit::Undo(E));
+
+  while (edit::Redo(E)) {}
+  REQUIRE(E.numrows == 2);
+  CHECK(E.row[0].chars == "int x");
+  CHECK(E.row[1].chars == "y");
+  CHECK(E.cy == 1);
+  CHECK(E.cx == 1);
+
+  // Joining rows with backspace, splitting them and pasting
+  E.cy = 1;
+  E.cx = 0;
+  edit::DelChar();
+  CHECK(E.row[0].chars == "int xy");
+  E.cx = 4;
+  edit::InsertNewLine();
+  CHECK(E.row[1].chars == "xy");
+  edit::InsertText(E, "a\r\nb");
+  CHECK(E.numrows == 3);
+  CHECK(E.row[1].chars == "a");
+  CHECK(E.row[2].chars == "bxy");
+  edit::DelChar();
+  CHECK(E.row[2].chars == "xy");
+
+  CHECK(edit::Undo(E));
+  CHECK(E.row[2].chars == "bxy");
+  CHECK(E.cx == 1);
+  CHECK(edit::Undo(E));
+  CHECK(E.numrows == 2);
+  CHECK(E.row[1].chars == "xy");
+  CHECK(edit::Undo(E));
+  CHECK(E.row[0].chars == "int xy");
+  CHECK(edit::Undo(E));
+  CHECK(E.numrows == 2);
+  CHECK(E.row[0].chars == "int x");
+  CHECK(E.row[1].chars == "y");
+  CHECK(E.row[1].rsize == 1);
+  CHECK(edit::Redo(E));
+  CHECK(edit::Redo(E));
+  CHECK(edit::Redo(E));
+  CHECK(edit::Redo(E));
+  CHECK_FALSE(edit::Redo(E));
+  CHECK(E.row[0].chars == "int ");
+  CHECK(E.row[1].chars == "a");
+  CHECK(E.row[2].chars == "xy");
+
+  // Replacing is one edit
+  search::matchIndex index;
+  index.update(E.row, "[a-z]", true);
+  CHECK(edit::ReplaceAll(E, index.matches(), "__") == 6);
+  CHECK(E.row[2].chars == "____");
+  CHECK(edit::Undo(E));
+  CHECK(E.row[0].chars == "int ");
+  CHECK(E.row[1].chars == "a");
+  CHECK(E.row[2].chars == "xy");
+
+  E.row.clear();
+  E.numrows = 0;
+  E.cx = E.cy = 0;
+  E.history.clear();
 }
@@ -0,0 +1,107 @@
+#include "events.h"
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <csignal>
+#include <functional>
+
+#include <unistd.h>
+
+using namespace std::chrono_literals;
+
+TEST_CASE("Timers repeat until they return false", "[events]")
+{
+  events::eventLoop events;
+  int ticks = 0;
+  events.every(1ms, [&] { return ++ticks < 3; });
+  events.every(20ms, [&] {
+    events.stop();
+    return false;
+  });
+  events.run();
+  CHECK(ticks == 3);
+}
+
+TEST_CASE("Idle tasks run between events", "[events]")
+{
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+
+  events::eventLoop events;
+  int slices = 0;
+  int reads = 0;
+  events.idle([&] {
+    slices++;
+    // Out of work: sleep until the pipe wakes the task up again
+    if (slices == 3) REQUIRE(write(fds[1], "x", 1) == 1);
+    return slices < 3;
+  });
+  events.watch(fds[0], [&] {
+    char c;
+    REQUIRE(read(fds[0], &c, 1) == 1);
+    reads++;
+  });
+  events.every(5ms, [&] {
+    if (slices >= 4) events.stop();
+    return true;
+  });
+  events.run();
+  CHECK(reads == 1);
+  CHECK(slices == 4);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_CASE("Signals are delivered as events", "[events]")
+{
+  events::eventLoop events;
+  int caught = 0;
+  events.signal(SIGUSR1, [&] {
+    caught++;
+    events.stop();
+  });
+  std::raise(SIGUSR1);
+  events.run();
+  CHECK(caught == 1);
+}
+
+TEST_CASE("Writable descriptors are polled until they are done", "[events]")
+{
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+
+  events::eventLoop events;
+  int calls = 0;
+  events.writable(fds[1], [&] { return ++calls < 3; });
+  // A pipe with room is always writable, so the loop only gets to the timer
+  // if the handler was dropped after it said it was done
+  events.every(5ms, [&] {
+    events.stop();
+    return false;
+  });
+  events.run();
+  CHECK(calls == 3);
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_CASE("Timers can add timers", "[events]")
+{
+  events::eventLoop events;
+  int shots = 0;
+  std::function<void()> shoot = [&] {
+    events.every(1ms, [&] {
+      // One-shot, arming the next one until three have gone off
+      if (++shots < 3) shoot();
+      return false;
+    });
+  };
+  shoot();
+  events.every(30ms, [&] {
+    events.stop();
+    return false;
+  });
+  events.run();
+  CHECK(shots == 3);
+}
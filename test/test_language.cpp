@@ -0,0 +1,174 @@
+#include "language.h"
+#include "lexer.h"
+#include "syntax.h"
+#include <catch2/catch_test_macros.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+void write(const std::filesystem::path &path, const std::string &text)
+{
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  out << text;
+}
+
+std::vector<std::string> strings(const char **list)
+{
+  std::vector<std::string> out;
+  for (auto **s = list; s && *s; s++) out.emplace_back(*s);
+  return out;
+}
+
+const char *PYTHON = "# Python, roughly\n"
+                     "name python\n"
+                     "match .py .pyw SConstruct\n"
+                     "keywords def class return\n"
+                     "\n"
+                     "keywords int| str|\n"
+                     "comment #\n"
+                     "multiline \"\"\" \"\"\"\n"
+                     "highlight numbers strings\n";
+
+}// namespace
+
+TEST_CASE("registry finds languages by name and extension", "[language]")
+{
+  syntax::registry languages;
+  CHECK(languages.size() == 1);
+  REQUIRE(languages.find("main.c") != nullptr);
+  CHECK(std::string(languages.find("main.c")->filetype) == "c");
+  CHECK(languages.find("src/edit.cpp") == languages.find("main.c"));
+  CHECK(languages.find("archive.tar.h") == languages.find("main.c"));
+  CHECK(languages.find("main.py") == nullptr);
+  CHECK(languages.find("c") == nullptr);
+  CHECK(languages.find("Makefile") == nullptr);
+  CHECK(languages.find("") == nullptr);
+}
+
+TEST_CASE("registry loads definition files and caches them", "[language]")
+{
+  auto dir = std::filesystem::temp_directory_path() / "kilo_test_language";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir / "syntax");
+  auto cache = dir / "cache" / "syntax.cache";
+  write(dir / "syntax" / "python.syntax", PYTHON);
+  write(dir / "syntax" / "make.syntax", "name make\nmatch Makefile .mk\ncomment #\n");
+  write(dir / "syntax" / "notes.txt", "not a definition");
+
+  {
+    syntax::registry languages;
+    CHECK(languages.load(dir / "syntax", cache) == 2);
+    CHECK(languages.error().empty());
+    CHECK_FALSE(languages.cached());
+    CHECK(languages.size() == 3);
+    CHECK(std::filesystem::exists(cache));
+
+    auto *py = languages.find("tools/build.py");
+    REQUIRE(py != nullptr);
+    CHECK(std::string(py->filetype) == "python");
+    CHECK(strings(py->filematch) == std::vector<std::string>{ ".py", ".pyw", "SConstruct" });
+    CHECK(strings(py->keywords) == std::vector<std::string>{ "def", "class", "return", "int|", "str|" });
+    CHECK(std::string(py->singleline_comment_start) == "#");
+    CHECK(std::string(py->multiline_comment_start) == "\"\"\"");
+    CHECK(std::string(py->multiline_comment_end) == "\"\"\"");
+    CHECK(py->flags == (HL_HIGHLIGHT_NUMBERS | HL_HIGHLIGHT_STRINGS));
+    CHECK(languages.find("SConstruct") == py);
+
+    auto *make = languages.find("Makefile");
+    REQUIRE(make != nullptr);
+    CHECK(languages.find("rules.mk") == make);
+    CHECK(make->multiline_comment_start == nullptr);
+    CHECK(make->keywords[0] == nullptr);
+    CHECK(make->flags == 0);
+
+    // The definitions highlight like the built-in ones
+    syntax::Compile(*py);
+    std::vector<syntax::span> runs;
+    py->lexer->run("def f(): return 42 # done", 0, runs);
+    CHECK(runs
+          == std::vector<syntax::span>{ { 0, 3, syntax::HL_KEYWORD1 },
+            { 9, 6, syntax::HL_KEYWORD1 },
+            { 16, 2, syntax::HL_NUMBER },
+            { 19, 6, syntax::HL_COMMENT } });
+  }
+
+  // The next start reads the cache, and gets the same languages
+  {
+    syntax::registry languages;
+    CHECK(languages.load(dir / "syntax", cache) == 2);
+    CHECK(languages.cached());
+    auto *py = languages.find("x.py");
+    REQUIRE(py != nullptr);
+    CHECK(strings(py->keywords) == std::vector<std::string>{ "def", "class", "return", "int|", "str|" });
+    CHECK(std::string(languages.find("Makefile")->filetype) == "make");
+  }
+
+  // A changed file makes the cache stale; a definition overrides a built-in
+  write(dir / "syntax" / "make.syntax", "name make\nmatch Makefile GNUmakefile\n");
+  write(dir / "syntax" / "c.syntax", "name c-ish\nmatch .c\nkeywords int\n");
+  {
+    syntax::registry languages;
+    CHECK(languages.load(dir / "syntax", cache) == 3);
+    CHECK_FALSE(languages.cached());
+    CHECK(languages.find("rules.mk") == nullptr);
+    CHECK(languages.find("GNUmakefile") == languages.find("Makefile"));
+    CHECK(std::string(languages.find("a.c")->filetype) == "c-ish");
+    CHECK(std::string(languages.find("a.h")->filetype) == "c");
+  }
+
+  // A cache that is no image at all is ignored
+  write(cache, "garbage");
+  {
+    syntax::registry languages;
+    CHECK(languages.load(dir / "syntax", cache) == 3);
+    CHECK_FALSE(languages.cached());
+  }
+  {
+    syntax::registry languages;
+    CHECK(languages.load(dir / "syntax", cache) == 3);
+    CHECK(languages.cached());
+  }
+
+  std::filesystem::remove_all(dir);
+}
+
+TEST_CASE("registry reports broken definition files", "[language]")
+{
+  auto dir = std::filesystem::temp_directory_path() / "kilo_test_language_broken";
+  std::filesystem::remove_all(dir);
+  std::filesystem::create_directories(dir);
+  auto cache = dir / "syntax.cache";
+  write(dir / "a.syntax", "name a\nmatch .a\ncolour red\n");
+  write(dir / "b.syntax", PYTHON);
+  write(dir / "c.syntax", "match .c3\n");
+
+  syntax::registry languages;
+  CHECK(languages.load(dir, cache) == 1);
+  CHECK(languages.error() == "a.syntax: line 3: unknown setting 'colour'");
+  CHECK(languages.find("x.py") != nullptr);
+  CHECK(languages.find("x.a") == nullptr);
+  // Not cached, so that the problem is reported again next time
+  CHECK_FALSE(std::filesystem::exists(cache));
+
+  for (auto bad : { "name\n", "name a b\n", "multiline /*\n", "highlight colours\n" }) {
+    write(dir / "a.syntax", std::string(bad) + "name a\nmatch .a\n");
+    syntax::registry again;
+    again.load(dir);
+    CHECK(again.error().starts_with("a.syntax: line 1: "));
+  }
+  write(dir / "a.syntax", "name a\n");
+  syntax::registry again;
+  again.load(dir);
+  CHECK(again.error() == "a.syntax: no match");
+
+  // No directory is no problem
+  syntax::registry none;
+  CHECK(none.load(dir / "missing", cache) == 0);
+  CHECK(none.error().empty());
+  CHECK(none.size() == 1);
+
+  std::filesystem::remove_all(dir);
+}
@@ -0,0 +1,49 @@
+#include "lineindex.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+#include <vector>
+
+TEST_CASE("ScanNewlines", "[lineindex]")
+{
+  std::string text;
+  for (int i = 0; i < 300; i++) text += std::string(static_cast<std::size_t>(i % 37), 'x') + "\n";
+  text += "tail";
+
+  std::vector<std::size_t> expected;
+  for (std::size_t i = 0; i < text.size(); i++) {
+    if (text[i] == '\n') expected.push_back(i + 5);
+  }
+
+  for (auto s : { edit::scanner::scalar, edit::scanner::sse2, edit::scanner::avx2, edit::scanner::automatic }) {
+    if (!edit::ScannerSupported(s)) continue;
+    std::vector<std::size_t> found;
+    edit::ScanNewlines(text.data(), text.size(), 5, found, s);
+    CHECK(found == expected);
+  }
+}
+
+TEST_CASE("IndexLines", "[lineindex]")
+{
+  std::string text = "one\r\ntwo\n\nfour\r\n\r\nlast";
+  auto index = edit::IndexLines(text.data(), text.size());
+  REQUIRE(index.lines() == 6);
+
+  std::vector<std::string> lines;
+  for (std::size_t n = 0; n < index.lines(); n++) lines.push_back(text.substr(index.start(n), index.length(n)));
+  CHECK(lines == std::vector<std::string>{ "one", "two", "", "four", "", "last" });
+
+  text = "terminated\n";
+  CHECK(edit::IndexLines(text.data(), text.size()).lines() == 1);
+  CHECK(edit::IndexLines(text.data(), 0).lines() == 0);
+}
+
+TEST_CASE("IndexLines across blocks", "[lineindex]")
+{
+  std::string text;
+  for (int i = 0; i < 1000; i++) text += std::to_string(i) + (i % 3 ? "\n" : "\r\n");
+  auto index = edit::IndexLines(text.data(), text.size());
+  REQUIRE(index.lines() == 1000);
+  for (std::size_t n = 0; n < index.lines(); n += 61) {
+    CHECK(text.substr(index.start(n), index.length(n)) == std::to_string(n));
+  }
+}
@@ -0,0 +1,106 @@
+#include "events.h"
+#include "output.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+TEST_CASE("Frames larger than the pipe are finished by flush", "[output]")
+{
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  int flags = fcntl(fds[1], F_GETFL);
+
+  std::string frame;
+  for (int i = 0; frame.size() < (1 << 20); i++) frame += std::to_string(i) + ' ';
+  auto expected = frame;
+
+  std::string received;
+  {
+    output::writer w(fds[1]);
+    // The writer has a description of its own; the one passed stays blocking
+    CHECK(fcntl(fds[1], F_GETFL) == flags);
+    CHECK((fcntl(w.descriptor(), F_GETFL) & O_NONBLOCK) != 0);
+
+    std::string ab = frame;
+    w.submit(ab);
+    // A pipe holds far less than a megabyte: the rest waits for the reader
+    REQUIRE(w.busy());
+
+    char buf[4096];
+    while (w.busy()) {
+      auto n = read(fds[0], buf, sizeof(buf));
+      REQUIRE(n > 0);
+      received.append(buf, static_cast<std::size_t>(n));
+      w.flush();
+    }
+  }
+  CHECK(fcntl(fds[1], F_GETFL) == flags);
+
+  close(fds[1]);
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fds[0], buf, sizeof(buf))) > 0) received.append(buf, static_cast<std::size_t>(n));
+  close(fds[0]);
+  CHECK(received == expected);
+}
+
+TEST_CASE("Waiting for output stops at pending input", "[output]")
+{
+  int out[2], in[2];
+  REQUIRE(pipe(out) == 0);
+  REQUIRE(pipe(in) == 0);
+  {
+    output::writer w(out[1]);
+    std::string ab(1 << 20, 'x');
+    w.submit(ab);
+    REQUIRE(w.busy());
+
+    REQUIRE(write(in[1], "k", 1) == 1);
+    CHECK(w.wait(in[0]));
+    CHECK(w.busy());
+
+    // Throw the output away so the destructor can finish the frame
+    char buf[1 << 16];
+    fcntl(out[0], F_SETFL, O_NONBLOCK);
+    while (w.busy()) {
+      while (read(out[0], buf, sizeof(buf)) > 0) {}
+      w.flush();
+    }
+  }
+  for (int fd : { out[0], out[1], in[0], in[1] }) close(fd);
+}
+
+TEST_CASE("The event loop finishes a frame when the terminal can take more", "[output]")
+{
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  std::string received;
+  {
+    output::writer w(fds[1]);
+    std::string ab(1 << 20, 'x');
+    w.submit(ab);
+    REQUIRE(w.busy());
+
+    events::eventLoop events;
+    int flushes = 0;
+    events.writable(w.descriptor(), [&] {
+      flushes++;
+      return !w.flush();
+    });
+    events.watch(fds[0], [&] {
+      char buf[1 << 16];
+      ssize_t n;
+      while ((n = read(fds[0], buf, sizeof(buf))) > 0) received.append(buf, static_cast<std::size_t>(n));
+      if (received.size() == (1 << 20)) events.stop();
+    });
+    events.run();
+    CHECK_FALSE(w.busy());
+    CHECK(flushes > 0);
+  }
+  CHECK(received == std::string(1 << 20, 'x'));
+  close(fds[0]);
+  close(fds[1]);
+}
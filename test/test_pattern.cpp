@@ -0,0 +1,123 @@
+#include "pattern.h"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace {
+
+using spans = std::vector<std::pair<std::size_t, std::size_t>>;
+
+spans find(const std::string &expression, const std::string &text)
+{
+  search::pattern p(expression);
+  spans out;
+  p.find(text, out);
+  return out;
+}
+
+}// namespace
+
+TEST_CASE("pattern finds leftmost-longest matches", "[pattern]")
+{
+  CHECK(find("abc", "xabcabc") == spans{ { 1, 3 }, { 4, 3 } });
+  CHECK(find("a+", "baaab aa") == spans{ { 1, 3 }, { 6, 2 } });
+  CHECK(find("a|ab|abc", "abcd") == spans{ { 0, 3 } });
+  CHECK(find("x*", "axxb") == spans{ { 1, 2 } });
+  CHECK(find("(ab)+c?", "ababcab") == spans{ { 0, 5 }, { 5, 2 } });
+  CHECK(find("colou?r", "color colour colouur") == spans{ { 0, 5 }, { 6, 6 } });
+  CHECK(find("a.c", "abc a c ac") == spans{ { 0, 3 }, { 4, 3 } });
+  CHECK(find("", "abc").empty());
+}
+
+TEST_CASE("pattern classes, escapes and counts", "[pattern]")
+{
+  CHECK(find("[0-9]+", "id=42, n=7") == spans{ { 3, 2 }, { 9, 1 } });
+  CHECK(find("\\d{3}", "12 1234 567") == spans{ { 3, 3 }, { 8, 3 } });
+  CHECK(find("\\d{2,3}", "1 12 1234") == spans{ { 2, 2 }, { 5, 3 } });
+  CHECK(find("a{2,}", "a aa aaaa") == spans{ { 2, 2 }, { 5, 4 } });
+  CHECK(find("\"[^\"]*\"", "x = \"a b\" + \"\"") == spans{ { 4, 5 }, { 12, 2 } });
+  CHECK(find("\\w+", "foo_1 bar") == spans{ { 0, 5 }, { 6, 3 } });
+  CHECK(find("\\s+", "a \t b") == spans{ { 1, 3 } });
+  CHECK(find("\\S+", "a \t bc") == spans{ { 0, 1 }, { 4, 2 } });
+  CHECK(find("\\.\\*", "a.*b") == spans{ { 1, 2 } });
+  CHECK(find("[]a]+", "x]a]y") == spans{ { 1, 3 } });
+  CHECK(find("[a-]+", "b-a-c") == spans{ { 1, 3 } });
+  CHECK(find("x{", "x{1") == spans{ { 0, 2 } });
+  // A brace that starts no count is a literal one
+  CHECK(find("a{,2}", "aa a{,2}") == spans{ { 3, 5 } });
+  CHECK(find("a{x}", "a{x}") == spans{ { 0, 4 } });
+  CHECK(find("a{3,1}", "aaa a{3,1}") == spans{ { 4, 6 } });
+  CHECK(find("a{2", "aa a{2") == spans{ { 3, 3 } });
+  CHECK(find("a{1}{2}", "a aa") == spans{ { 2, 2 } });
+}
+
+TEST_CASE("pattern anchors", "[pattern]")
+{
+  CHECK(find("^ab", "abab") == spans{ { 0, 2 } });
+  CHECK(find("ab$", "abab") == spans{ { 2, 2 } });
+  CHECK(find("^a*$", "aaa") == spans{ { 0, 3 } });
+  CHECK(find("^a*$", "aab").empty());
+  CHECK(find("^$", "").empty());
+  CHECK(find("b|^a", "aab") == spans{ { 0, 1 }, { 2, 1 } });
+}
+
+TEST_CASE("pattern does not blow up", "[pattern]")
+{
+  // Exponential for a backtracking matcher
+  std::string text(5000, 'a');
+  CHECK(find("(a*)*b", text).empty());
+  CHECK(find("(a|aa)+$", text) == spans{ { 0, 5000 } });
+
+  // Quadratic for a matcher that tries every position in turn: each 'a' starts
+  // a run up to the end of the row that fails, before 'c' is found there
+  CHECK(find("a[^b]*b|c", "a c b") == spans{ { 0, 5 } });
+  CHECK(find("a[^b]*b|c", "aac") == spans{ { 2, 1 } });
+  auto seconds = [](std::size_t size) {
+    std::string row(size, 'a');
+    row.back() = 'c';
+    auto best = 1e9;
+    for (int round = 0; round < 3; round++) {
+      auto start = std::chrono::steady_clock::now();
+      CHECK(find("a[^b]*b|c", row) == spans{ { size - 1, 1 } });
+      best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+    }
+    return best;
+  };
+  auto small = seconds(25000);
+  auto large = seconds(200000);
+  // Eight times the row, 64 times the time if quadratic
+  CHECK(large < 24 * small + 0.01);
+
+  // Many states: the DFA cache is flushed and rebuilt as needed
+  search::pattern p("[ab]*a[ab]{12}c");
+  std::string many;
+  for (int i = 0; i < 20000; i++) many += (i * 7919 % 13) < 6 ? 'a' : 'b';
+  many[many.size() - 13] = 'a';
+  many += 'c';
+  spans out;
+  p.find(many, out);
+  REQUIRE(out.size() == 1);
+  CHECK(out[0] == std::make_pair(std::size_t{ 0 }, many.size()));
+  CHECK(p.states() <= 2 * 2048);
+
+  // A copy shares the program, not the states
+  search::pattern copy(p);
+  CHECK(copy.states() == 2);
+}
+
+TEST_CASE("pattern errors and required literal", "[pattern]")
+{
+  for (auto bad : { "(ab", "ab)", "[ab", "*a", "a\\", "\\q", "a{2000}", "(a{1000}){1000}" }) {
+    CHECK_THROWS_AS(search::pattern(bad), std::runtime_error);
+  }
+
+  CHECK(search::pattern("status=5\\d\\d").required() == "status=5");
+  CHECK(search::pattern("(err)or: [a-z]+ failed").required() == "error: ");
+  CHECK(search::pattern("x+yz").required() == "yz");
+  CHECK(search::pattern("a|b").required().empty());
+  CHECK(search::pattern("(foo)?bar").required() == "bar");
+}
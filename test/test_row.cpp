@@ -51,7 +51,7 @@ bool checkUpdate(const std::string &chars, const std::string &render)
   r.chars = chars;
   r.size = chars.length();
   row::Update(r);
-  if ((r.render == render) && (r.rsize == render.length())) {
+  if ((r.render() == render) && (r.rsize == render.length())) {
     return true;
   } else {
     return false;
@@ -124,3 +124,78 @@ TEST_CASE("DelChar", "[row]")
   row::DelChar(r, 10);
   CHECK("134567" == r.chars);
 }
+
+TEST_CASE("Column conversions on long rows", "[row]")
+{
+  // Long rows go through the tab index; check it against the render
+  edit::erow r;
+  for (int i = 0; i < 300; i++) r.chars += (i % 7 == 0) ? "\t" : (i % 3 == 0 ? "ab\t" : "x");
+  r.size = r.chars.length();
+  row::Update(r);
+
+  std::size_t rx = 0;
+  for (std::size_t cx = 0; cx < r.size; cx++) {
+    REQUIRE(row::CxToRx(r, cx) == rx);
+    auto width = (r.chars[cx] == '\t') ? 8 - rx % 8 : 1;
+    for (std::size_t k = 0; k < width; k++) REQUIRE(row::RxToCx(r, rx + k) == cx);
+    rx += width;
+  }
+  CHECK(row::CxToRx(r, r.size) == r.rsize);
+  CHECK(row::RxToCx(r, r.rsize + 5) == r.size);
+
+  // Edits drop the index
+  row::InsertChar(r, 0, '\t');
+  CHECK(row::CxToRx(r, 1) == 8);
+  CHECK(row::CxToRx(r, r.size) == r.rsize);
+}
+
+TEST_CASE("Edits re-render the row incrementally", "[row]")
+{
+  edit::erow r;
+  for (int i = 0; i < 400; i++) r.chars += (i % 5 == 0) ? '\t' : static_cast<char>('a' + i % 26);
+  r.size = r.chars.length();
+  row::Update(r);
+  row::CxToRx(r, 0);// builds the tab index, which edits keep up to date
+
+  unsigned seed = 7;
+  for (int n = 0; n < 500; n++) {
+    seed = seed * 1103515245 + 12345;
+    auto at = static_cast<int>((seed >> 8) % (r.size + 1));
+    if (n % 3 == 2) {
+      row::DelChar(r, at);
+    } else if (n % 7 == 0) {
+      row::AppendString(r, "x\ty");
+    } else {
+      row::InsertChar(r, at, (n % 2) ? '\t' : 'z');
+    }
+
+    edit::erow fresh;
+    fresh.chars = r.chars;
+    fresh.size = r.size;
+    row::Update(fresh);
+    REQUIRE(r.render() == fresh.render());
+    REQUIRE(r.rsize == fresh.rsize);
+    auto cx = static_cast<std::size_t>(at) % (r.size + 1);
+    REQUIRE(row::CxToRx(r, cx) == row::CxToRx(fresh, cx));
+  }
+}
+
+TEST_CASE("Rows without tabs are rendered from chars", "[row]")
+{
+  edit::erow r;
+  r.chars = "int x = 1;";
+  r.size = r.chars.length();
+  row::Update(r);
+  CHECK(r.expanded.empty());
+  CHECK(r.render().data() == r.chars.data());
+  CHECK(r.rsize == r.size);
+
+  // A tab gives the row its own render, and removing it takes it away again
+  row::InsertChar(r, 3, '\t');
+  CHECK(r.render() == "int      x = 1;");
+  CHECK(r.render().data() != r.chars.data());
+  row::DelChar(r, 3);
+  CHECK(r.expanded.empty());
+  CHECK(r.render() == "int x = 1;");
+  CHECK(r.rsize == r.size);
+}
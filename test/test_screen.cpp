@@ -0,0 +1,85 @@
+#include "screen.h"
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <string>
+
+namespace {
+
+screen::frame makeFrame()
+{
+  screen::frame f;
+  f.resize(10, 40);
+  for (std::size_t y = 0; y < 10; y++) {
+    const char *text = "int main(void) { return 0; }";
+    f.print(y, 0, text, strlen(text));
+  }
+  f.print(9, 0, "status", 6, screen::Attr(Term::fg::reset, true));
+  return f;
+}
+
+}// namespace
+
+TEST_CASE("Unchanged frame", "[screen]")
+{
+  auto shown = makeFrame();
+  auto next = makeFrame();
+  std::string ab;
+  next.diff(shown, ab);
+  CHECK(ab.empty());
+}
+
+TEST_CASE("Single cell change", "[screen]")
+{
+  auto shown = makeFrame();
+  auto next = makeFrame();
+  next.set(4, 12, 'X');
+  std::string ab;
+  next.diff(shown, ab);
+  CHECK(ab == "\x1b[5;13HX");
+}
+
+TEST_CASE("Nearby changes on one line", "[screen]")
+{
+  auto shown = makeFrame();
+  auto next = makeFrame();
+  next.set(2, 1, 'X');
+  next.set(2, 3, 'Y');
+  next.set(2, 20, 'Z', screen::Attr(Term::fg::red));
+  std::string ab;
+  next.diff(shown, ab);
+  // The short gap is rewritten, the long one skipped with a cursor motion
+  CHECK(ab == "\x1b[3;2HXtY\x1b[16C\x1b[0;31mZ\x1b[0m");
+}
+
+TEST_CASE("Shortened line is erased", "[screen]")
+{
+  auto shown = makeFrame();
+  auto next = makeFrame();
+  for (std::size_t x = 3; x < 40; x++) next.set(0, x, ' ');
+  std::string ab;
+  next.diff(shown, ab);
+  // Column 4 is a blank in both frames
+  CHECK(ab == "\x1b[1;5H\x1b[K");
+}
+
+TEST_CASE("Resized frame is drawn in full", "[screen]")
+{
+  screen::frame shown;
+  auto next = makeFrame();
+  std::string ab;
+  next.diff(shown, ab);
+  CHECK(ab.find("int main(void) { return 0; }") != std::string::npos);
+  CHECK(ab.find("status") != std::string::npos);
+}
+
+TEST_CASE("Reversed colors use one escape sequence", "[screen]")
+{
+  screen::frame shown, next;
+  shown.resize(1, 4);
+  next.resize(1, 4);
+  next.set(0, 0, 'A', screen::Attr(Term::fg::cyan, true));
+  next.set(0, 1, 'B', screen::Attr(Term::fg::reset, true));
+  std::string ab;
+  next.diff(shown, ab);
+  CHECK(ab == "\x1b[1;1H\x1b[0;36;7mA\x1b[0;7mB\x1b[0m");
+}
@@ -0,0 +1,171 @@
+#include "search.h"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+
+std::vector<std::size_t> naive(const std::string &text, const std::string &needle)
+{
+  std::vector<std::size_t> found;
+  for (auto pos = text.find(needle); pos != std::string::npos; pos = text.find(needle, pos + 1)) found.push_back(pos);
+  return found;
+}
+
+edit::erow makeRow(const std::string &s)
+{
+  edit::erow r{};
+  r.chars = s;
+  r.size = s.length();
+  return r;
+}
+
+}// namespace
+
+TEST_CASE("Scan", "[search]")
+{
+  std::string text;
+  for (int i = 0; i < 200; i++) text += std::string(static_cast<std::size_t>(i % 23), 'a') + "ab" + std::to_string(i);
+
+  for (std::string needle : { "a", "ab", "aab", "aaaa", "b1", "ab19", "aaaaaaaaaaaaaaaaaaaab", "nothere" }) {
+    auto expected = naive(text, needle);
+    for (auto s : { edit::scanner::scalar, edit::scanner::sse2, edit::scanner::avx2, edit::scanner::automatic }) {
+      if (!edit::ScannerSupported(s)) continue;
+      std::vector<std::size_t> found;
+      search::Scan(text, needle, found, s);
+      CHECK(found == expected);
+    }
+  }
+
+  // Matches in the last bytes are found by the tail of the SIMD scanners
+  std::vector<std::size_t> found;
+  search::Scan("xxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxxyz", "yz", found);
+  CHECK(found == std::vector<std::size_t>{ 39 });
+}
+
+TEST_CASE("matchIndex narrows as the query grows", "[search]")
+{
+  edit::rowBuffer rows;
+  for (int i = 0; i < 3000; i++) rows.insert(rows.size(), makeRow("aaab " + std::to_string(i) + " aab"));
+
+  search::matchIndex index;
+  index.update(rows, "aa");
+  CHECK(index.matches().size() == 3000 * 3);
+  CHECK(index.matches()[1] == search::match{ 0, 1, 2 });
+
+  // "aab" starts at a match of "aa" that does not survive as a match of its
+  // own when overlapping matches are skipped
+  index.update(rows, "aab");
+  REQUIRE(index.matches().size() == 3000 * 2);
+  CHECK(index.matches()[0] == search::match{ 0, 1, 3 });
+  CHECK(index.matches()[5999] == search::match{ 2999, 10, 3 });
+
+  index.update(rows, "aab 12");
+  CHECK(index.matches().size() == 111);
+  CHECK(index.complete());
+
+  // A shorter query is searched from scratch
+  index.update(rows, "b 299");
+  CHECK(index.matches().size() == 11);
+  index.update(rows, "");
+  CHECK(index.matches().empty());
+}
+
+TEST_CASE("matchIndex searches large buffers in the background", "[search]")
+{
+  edit::rowBuffer rows;
+  for (int i = 0; i < 200000; i++) rows.insert(rows.size(), makeRow("row " + std::to_string(i) + " end"));
+
+  search::matchIndex index;
+  index.update(rows, "row 1");
+  CHECK(index.wait(std::chrono::seconds(30)));
+  REQUIRE(index.complete());
+  // 1, 10-19, 100-199 and so on up to 100000-199999
+  REQUIRE(index.matches().size() == 111111);
+  CHECK(std::is_sorted(index.matches().begin(), index.matches().end(), [](const auto &a, const auto &b) {
+    return a.row < b.row;
+  }));
+  CHECK(index.matches().front() == search::match{ 1, 0, 5 });
+  CHECK(index.matches().back() == search::match{ 199999, 0, 5 });
+
+  // A different query cancels the search in flight
+  index.update(rows, "d");
+  index.update(rows, "row 2");
+  CHECK(index.wait(std::chrono::seconds(30)));
+  CHECK(index.matches().size() == 11111);
+  CHECK(index.matches()[1] == search::match{ 20, 0, 5 });
+
+  index.update(rows, "row 23");
+  CHECK(index.matches().size() == 1111);
+  index.clear();
+  CHECK(index.matches().empty());
+
+  // Releasing the matches hands them over and clears the index
+  index.update(rows, "row 19999");
+  CHECK(index.wait(std::chrono::seconds(30)));
+  auto taken = index.release();
+  REQUIRE(taken.size() == 11);
+  CHECK(taken.front() == search::match{ 19999, 0, 9 });
+  CHECK(taken.back() == search::match{ 199999, 0, 9 });
+  CHECK(index.matches().empty());
+  CHECK(index.text().empty());
+  CHECK(index.complete());
+}
+
+TEST_CASE("matchIndex keeps the first matches of a query that matches too often", "[search]")
+{
+  edit::rowBuffer rows;
+  for (int i = 0; i < 200000; i++) rows.insert(rows.size(), makeRow("aaaaaaaaaaa"));
+
+  // Whichever slice ends first, the matches kept are those of the first rows
+  search::matchIndex index;
+  index.update(rows, "a");
+  CHECK(index.wait(std::chrono::seconds(30)));
+  CHECK(!index.complete());
+  auto rowsKept = search::KILO_SEARCH_MAX_MATCHES / 11;
+  REQUIRE(index.matches().size() == rowsKept * 11);
+  CHECK(index.matches().front() == search::match{ 0, 0, 1 });
+  CHECK(index.matches().back() == search::match{ rowsKept - 1, 10, 1 });
+  for (std::size_t i = 0; i < index.matches().size(); i += 4099) {
+    CHECK(index.matches()[i] == search::match{ i / 11, i % 11, 1 });
+  }
+
+  // A longer query narrows those and goes on from the first row left out
+  index.update(rows, "aaaaaaaaaa");
+  CHECK(index.wait(std::chrono::seconds(30)));
+  CHECK(index.complete());
+  CHECK(index.matches().size() == 400000);
+}
+
+TEST_CASE("matchIndex searches for regular expressions", "[search]")
+{
+  edit::rowBuffer rows;
+  for (int i = 0; i < 50000; i++) {
+    rows.insert(rows.size(), makeRow("GET /" + std::to_string(i) + " status=" + std::to_string(200 + i % 400)));
+  }
+
+  search::matchIndex index;
+  index.update(rows, "status=5\\d\\d$", true);
+  CHECK(index.wait(std::chrono::seconds(30)));
+  REQUIRE(index.complete());
+  CHECK(index.matches().size() == 50000 / 4);
+  CHECK(index.matches().front() == search::match{ 300, 9, 10 });
+
+  // Without a literal to look for, every row goes through the DFA
+  index.update(rows, "/[0-9]*7 s", true);
+  CHECK(index.wait(std::chrono::seconds(30)));
+  CHECK(index.matches().size() == 5000);
+  CHECK(index.matches().front() == search::match{ 7, 4, 4 });
+
+  // Literal search again, not narrowed from the regex matches
+  index.update(rows, "/[0-9]*7 s");
+  CHECK(index.matches().empty());
+  CHECK(index.error().empty());
+
+  index.update(rows, "status=(5", true);
+  CHECK(index.matches().empty());
+  CHECK(index.error() == "missing )");
+  CHECK(index.complete());
+}
@@ -0,0 +1,354 @@
+#include "edit.h"
+#include "lexer.h"
+#include "row.h"
+#include "syntax.h"
+#include <algorithm>
+#include <catch2/catch_test_macros.hpp>
+#include <cstring>
+#include <random>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace {
+
+edit::editorConfig &makeC(edit::editorConfig &E, std::size_t lines, bool comments = true)
+{
+  E.numrows = 0;
+  E.dirty = 0;
+  E.syntax = nullptr;
+  for (std::size_t i = 0; i < lines; i++) {
+    std::string s = "int x = " + std::to_string(i) + ";";
+    if (!comments) {
+      edit::Insert(E, static_cast<int>(E.numrows), s);
+      continue;
+    }
+    if (i % 997 == 5) s += " /* opens a comment";
+    if (i % 997 == 400) s = "still open */ return 1;";
+    if (i % 5003 == 17) s = "/* never closed in this chunk";
+    edit::Insert(E, static_cast<int>(E.numrows), s);
+  }
+  E.filename = "test.c";
+  return E;
+}
+
+// The per-byte loop syntax::Highlight() ran before syntax::lexer, to check
+// the lexer against: classes of text, and whether a comment is open at its end
+std::pair<std::string, int> highlightBytes(const edit::editorSyntax &syntax, const std::string &render, int in_comment)
+{
+  auto rsize = render.size();
+  std::string hl(rsize, syntax::HL_NORMAL);
+  auto sep = [](char c) { return isspace(c) || c == '\0' || strchr(",.()+-/*=~%<>[];", c) != nullptr; };
+  const auto *scs = syntax.singleline_comment_start;
+  const auto *mcs = syntax.multiline_comment_start;
+  const auto *mce = syntax.multiline_comment_end;
+  auto scs_len = scs ? strlen(scs) : 0;
+  auto mcs_len = mcs ? strlen(mcs) : 0;
+  auto mce_len = mce ? strlen(mce) : 0;
+  auto prev_sep = true;
+  auto in_string = 0;
+  std::size_t i = 0;
+  while (i < rsize) {
+    auto c = render[i];
+    auto prev_hl = (i > 0) ? hl[i - 1] : static_cast<char>(syntax::HL_NORMAL);
+    if (scs_len && !in_string && !in_comment && !strncmp(&render[i], scs, scs_len)) {
+      std::fill(hl.begin() + static_cast<long>(i), hl.end(), syntax::HL_COMMENT);
+      break;
+    }
+    if (mcs_len && mce_len && !in_string) {
+      if (in_comment) {
+        hl[i] = syntax::HL_MLCOMMENT;
+        if (!strncmp(&render[i], mce, mce_len)) {
+          for (std::size_t k = 0; k < mce_len; k++) hl[i + k] = syntax::HL_MLCOMMENT;
+          i += mce_len;
+          in_comment = 0;
+          prev_sep = true;
+        } else {
+          i++;
+        }
+        continue;
+      } else if (!strncmp(&render[i], mcs, mcs_len)) {
+        for (std::size_t k = 0; k < mcs_len; k++) hl[i + k] = syntax::HL_MLCOMMENT;
+        i += mcs_len;
+        in_comment = 1;
+        continue;
+      }
+    }
+    if (syntax.flags & HL_HIGHLIGHT_STRINGS) {
+      if (in_string) {
+        hl[i] = syntax::HL_STRING;
+        if (c == '\\' && i + 1 < rsize) {
+          hl[i + 1] = syntax::HL_STRING;
+          i += 2;
+          continue;
+        }
+        if (c == in_string) in_string = 0;
+        i++;
+        prev_sep = true;
+        continue;
+      } else if (c == '"' || c == '\'') {
+        in_string = static_cast<unsigned char>(c);
+        hl[i] = syntax::HL_STRING;
+        i++;
+        continue;
+      }
+    }
+    if (syntax.flags & HL_HIGHLIGHT_NUMBERS) {
+      if ((isdigit(c) && (prev_sep || prev_hl == syntax::HL_NUMBER)) || (c == '.' && prev_hl == syntax::HL_NUMBER)) {
+        hl[i] = syntax::HL_NUMBER;
+        i++;
+        prev_sep = false;
+        continue;
+      }
+    }
+    if (prev_sep) {
+      bool found = false;
+      for (int j = 0; syntax.keywords[j]; j++) {
+        auto klen = strlen(syntax.keywords[j]);
+        auto kw2 = syntax.keywords[j][klen - 1] == '|';
+        if (kw2) klen--;
+        if (!strncmp(&render[i], syntax.keywords[j], klen) && sep(render[i + klen])) {
+          for (std::size_t k = 0; k < klen; k++) hl[i + k] = kw2 ? syntax::HL_KEYWORD2 : syntax::HL_KEYWORD1;
+          i += klen;
+          found = true;
+          break;
+        }
+      }
+      if (found) {
+        prev_sep = false;
+        continue;
+      }
+    }
+    prev_sep = sep(c);
+    i++;
+  }
+  return { hl, in_comment };
+}
+
+std::pair<std::string, int> lexBytes(const edit::editorSyntax &syntax, const std::string &render, int in_comment)
+{
+  std::vector<syntax::span> runs;
+  in_comment = syntax.lexer->run(render, in_comment, runs);
+  std::string hl(render.size(), syntax::HL_NORMAL);
+  std::size_t end = 0;
+  for (const auto &r : runs) {
+    // In order, not overlapping, and merged where they touch
+    CHECK(r.start >= end);
+    CHECK((r.start > end || end == 0 || hl[end - 1] != r.hl));
+    CHECK(r.hl != syntax::HL_NORMAL);
+    end = r.start + r.length;
+    std::fill(hl.begin() + r.start, hl.begin() + end, static_cast<char>(r.hl));
+  }
+  CHECK(end <= render.size());
+  return { hl, in_comment };
+}
+
+}// namespace
+
+TEST_CASE("HighlightAll matches serial highlighting", "[syntax]")
+{
+  auto mismatches = [](auto fill) {
+    edit::editorConfig parallel{};
+    fill(parallel);
+    syntax::SelectHighlight(parallel);
+    REQUIRE(parallel.syntax != nullptr);
+
+    edit::editorConfig serial{};
+    fill(serial);
+    syntax::SelectHighlight(serial);
+    for (std::size_t i = 0; i < serial.numrows; i++) syntax::Update(serial, i);
+
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < serial.numrows; i++) {
+      const auto &p = parallel.row[i];
+      const auto &s = serial.row[i];
+      if (p.hl_open_comment != s.hl_open_comment || !std::ranges::equal(p.highlight(), s.highlight())) count++;
+    }
+    return count;
+  };
+  CHECK(mismatches([](edit::editorConfig &E) { makeC(E, 60000); }) == 0);
+
+  // The first row of a chunk closes the comment it was entered with, then
+  // opens another: it ends up open, where the guess had it closed
+  auto reopened = mismatches([](edit::editorConfig &E) {
+    makeC(E, 8192, false);
+    E.row[2047].chars = "/* open";
+    E.row[2048].chars = "\"*/\" x /*";
+    for (auto at : { 2047, 2048 }) {
+      E.row[at].size = E.row[at].chars.size();
+      row::Update(E.row[at]);
+    }
+  });
+  CHECK(reopened == 0);
+}
+
+TEST_CASE("Comment state carries to the next row", "[syntax]")
+{
+  edit::editorConfig E{};
+  E.screenrows = 10;
+  E.filename = "test.c";
+  syntax::SelectHighlight(E);
+  edit::Insert(E, 0, "int a; /* start");
+  edit::Insert(E, 1, "int b;");
+  syntax::Update(E, 0);
+  syntax::Update(E, 1);
+  CHECK(E.row[1].highlightAt(0) == syntax::HL_MLCOMMENT);
+
+  // Closing the comment re-highlights the following row
+  E.row[0].chars += " */";
+  E.row[0].size = E.row[0].chars.size();
+  row::Update(E.row[0]);
+  syntax::Update(E, 0);
+  CHECK(E.row[1].highlightAt(0) == syntax::HL_KEYWORD2);
+}
+
+TEST_CASE("Opening a comment only re-highlights the screen", "[syntax]")
+{
+  edit::editorConfig E{};
+  E.screenrows = 20;
+  makeC(E, 100000, false);
+  syntax::SelectHighlight(E);
+  REQUIRE(E.hl_valid == E.numrows);
+
+  E.cx = 0;
+  E.cy = 0;
+  E.row[0].chars = "/* " + E.row[0].chars;
+  E.row[0].size = E.row[0].chars.size();
+  row::Update(E.row[0]);
+  syntax::Update(E, 0);
+  CHECK(E.hl_valid <= 20);
+  CHECK(E.row[10].highlightAt(0) == syntax::HL_MLCOMMENT);
+
+  // Rows further down are highlighted when they are needed, but the
+  // watermark only moves so far towards them at once
+  syntax::Ensure(E, 50000, 50020);
+  CHECK(E.hl_valid > 20);
+  CHECK(E.hl_valid < 10000);
+  CHECK(!E.row[50000].highlight().empty());
+
+  edit::editorConfig fresh{};
+  makeC(fresh, 100000, false);
+  fresh.row[0].chars = E.row[0].chars;
+  fresh.row[0].size = E.row[0].size;
+  row::Update(fresh.row[0]);
+  syntax::SelectHighlight(fresh);
+
+  // In idle slices the watermark reaches the end of the buffer, and puts
+  // those rows right on the way
+  std::size_t slices = 1;
+  while (syntax::Advance(E, 4096)) slices++;
+  CHECK(slices == 24);
+  for (std::size_t i = 50000; i < 50020; i++) {
+    CHECK(std::ranges::equal(E.row[i].highlight(), fresh.row[i].highlight()));
+  }
+  CHECK(E.hl_valid == E.numrows);
+  CHECK(std::ranges::equal(E.row[99999].highlight(), fresh.row[99999].highlight()));
+}
+
+TEST_CASE("Highlighting rows that didn't change copies no shared chunk", "[syntax]")
+{
+  edit::editorConfig E{};
+  E.screenrows = 20;
+  makeC(E, 5000);
+  syntax::SelectHighlight(E);
+
+  // A row that was copied on write is somewhere else than the snapshot's
+  auto snap = E.row.snapshot();
+  auto shared = [&] {
+    std::size_t same = 0, i = 0;
+    snap.forEach([&](std::string_view line) { same += line.data() == std::as_const(E.row)[i++].chars.data(); });
+    return same;
+  };
+  REQUIRE(shared() == 5000);
+
+  // The watermark catching up, and rows past it being drawn, find the
+  // highlighting they would write already there
+  E.hl_valid = 0;
+  syntax::Ensure(E, 3000, 3020);
+  syntax::Ensure(E, 0, 20);
+  while (syntax::Advance(E, 1000)) {}
+  CHECK(E.hl_valid == E.numrows);
+  CHECK(shared() == 5000);
+
+  // A row that is written to is copied, with the chunk it is in
+  E.row[4000].chars += ' ';
+  CHECK(shared() < 5000);
+}
+
+TEST_CASE("keywordTable finds every keyword with one lookup", "[syntax]")
+{
+  std::vector<std::string> words;
+  for (int i = 0; i < 600; i++) words.push_back("kw" + std::to_string(i * 7919 % 10007) + (i % 3 ? "" : "|"));
+  words.push_back("operator->");
+  words.push_back("kw0");// a second kw0 loses to the first
+  std::vector<const char *> list;
+  for (const auto &w : words) list.push_back(w.c_str());
+  list.push_back(nullptr);
+
+  syntax::keywordTable table(list.data());
+  CHECK(table.size() == 601);
+  for (int i = 0; i < 600; i++) {
+    auto word = "kw" + std::to_string(i * 7919 % 10007);
+    CHECK(table.find(word) == (i % 3 ? syntax::HL_KEYWORD1 : syntax::HL_KEYWORD2));
+    CHECK(table.find(word + "x") == syntax::HL_NORMAL);
+  }
+  CHECK(table.find("") == syntax::HL_NORMAL);
+  CHECK(table.find("kw") == syntax::HL_NORMAL);
+  CHECK(table.find("operator") == syntax::HL_NORMAL);
+
+  // A keyword with a separator in it is matched at the text
+  CHECK(table.findIrregular("operator->(") == std::make_pair(std::size_t{ 10 }, static_cast<unsigned char>(syntax::HL_KEYWORD1)));
+  CHECK(table.findIrregular("operator->x").first == 0);
+
+  const char *none[] = { nullptr };
+  CHECK(syntax::keywordTable(none).find("if") == syntax::HL_NORMAL);
+}
+
+TEST_CASE("Keywords are highlighted as whole tokens", "[syntax]")
+{
+  edit::editorConfig E{};
+  edit::Insert(E, 0, "unsigned int ifx(if) {return(x.int);} signedness");
+  E.filename = "test.c";
+  syntax::SelectHighlight(E);
+  REQUIRE(E.syntax != nullptr);
+  REQUIRE(E.syntax->lexer != nullptr);
+
+  const auto &r = E.row[0];
+  std::string classes;
+  for (std::size_t i = 0; i < r.rsize; i++) classes += static_cast<char>('0' + r.highlightAt(i));
+  CHECK(classes == "444444440444000003300000000000044400000000000000");
+}
+
+TEST_CASE("lexer highlights exactly as the per-byte loop did", "[syntax]")
+{
+  // C, as the editor has it, and a made-up syntax whose comments start with
+  // letters and whose keywords have separators in them, which keep the lexer
+  // from skipping over words and blanks
+  edit::editorConfig E{};
+  E.filename = "test.c";
+  syntax::SelectHighlight(E);
+  REQUIRE(E.syntax != nullptr);
+  const char *odd_keywords[] = { "if", "end|", "a.b", "go to|", nullptr };
+  edit::editorSyntax odd{ "odd", nullptr, odd_keywords, "REM", "begin", "end", HL_HIGHLIGHT_NUMBERS, nullptr };
+  syntax::Compile(odd);
+  edit::editorSyntax bare{ "bare", nullptr, odd_keywords, nullptr, "(*", nullptr, HL_HIGHLIGHT_STRINGS, nullptr };
+  syntax::Compile(bare);
+
+  std::string_view pieces[] = { "\"", "'", "\\", "/", "*", "/*", "*/", "//", " ", "    ", "\t", ".", "1", "42", "3.14", "x", "_y",
+    "int", "if", "return", "signed", "a.b", "go to", "REM", "begin", "end", "(", ")", ";", "abcdefghijklmnopqrstuvwxyz_0123",
+    "                  ", "\x80", std::string_view("\0", 1) };
+  std::mt19937 rng(23);
+  for (const auto *s : { E.syntax, &odd, &bare }) {
+    for (int round = 0; round < 3000; round++) {
+      std::string text;
+      auto n = rng() % 24;
+      for (std::size_t k = 0; k < n; k++) text += pieces[rng() % std::size(pieces)];
+      for (int in_comment : { 0, 1 }) {
+        INFO(s->filetype << " \"" << text << "\" in_comment " << in_comment);
+        CHECK(lexBytes(*s, text, in_comment) == highlightBytes(*s, text, in_comment));
+      }
+    }
+  }
+}
@@ -0,0 +1,94 @@
+#include "undo.h"
+#include <catch2/catch_test_macros.hpp>
+#include <string>
+
+TEST_CASE("history groups and undoes records", "[undo]")
+{
+  undo::history h;
+  CHECK(h.undo().empty());
+
+  h.begin();
+  h.add(undo::op::insertRow, 3, 0, "");
+  h.add(undo::op::insertText, 3, 0, "x");
+  h.begin();
+  h.add(undo::op::deleteText, 1, 2, "ab\ncd");
+
+  auto group = h.undo();
+  REQUIRE(group.size() == 1);
+  CHECK(group[0].kind == undo::op::deleteText);
+  CHECK(h.text(group[0]) == "ab\ncd");
+
+  group = h.undo();
+  REQUIRE(group.size() == 2);
+  CHECK(group[0].kind == undo::op::insertRow);
+  CHECK(h.text(group[1]) == "x");
+  CHECK(h.undo().empty());
+
+  CHECK(h.redo().size() == 2);
+  // A new edit drops what could still be redone
+  h.begin();
+  h.add(undo::op::insertText, 0, 0, "new");
+  CHECK(h.redo().empty());
+  group = h.undo();
+  REQUIRE(group.size() == 1);
+  CHECK(h.text(group[0]) == "new");
+}
+
+TEST_CASE("history merges typing up to the end of a word", "[undo]")
+{
+  undo::history h;
+  std::string typed = "hello world";
+  for (std::size_t i = 0; i < typed.size(); i++) h.type(0, i, typed[i]);
+  CHECK(h.size() == 2);
+
+  // Typing somewhere else starts a new record
+  h.type(1, 0, '!');
+  CHECK(h.size() == 3);
+
+  auto group = h.undo();
+  CHECK(h.text(group[0]) == "!");
+  group = h.undo();
+  REQUIRE(group.size() == 1);
+  CHECK(group[0].row == 0);
+  CHECK(group[0].col == 6);
+  CHECK(h.text(group[0]) == "world");
+  group = h.undo();
+  CHECK(h.text(group[0]) == "hello ");
+
+  // Typing after an undo does not go on in the record undone
+  h.redo();
+  h.type(0, 6, 'x');
+  CHECK(h.size() == 2);
+}
+
+TEST_CASE("history stays within its limit", "[undo]")
+{
+  const std::size_t limit = 1 << 20;
+  undo::history h(limit);
+
+  // A day of typing: millions of keystrokes, a word at a time
+  std::string word = "word ";
+  std::size_t col = 0;
+  for (int i = 0; i < 3000000; i++) h.type(0, col++, word[static_cast<std::size_t>(i) % word.size()]);
+  CHECK(h.memory() <= limit + (256 << 10));
+  CHECK(h.size() > 10000);
+
+  // The newest edits are the ones kept
+  auto group = h.undo();
+  REQUIRE(group.size() == 1);
+  CHECK(group[0].col == col - 5);
+  CHECK(h.text(group[0]) == "word ");
+  std::size_t groups = 1;
+  while (!h.undo().empty()) groups++;
+  CHECK(groups == h.size());
+
+  // An edit larger than the limit can't be undone, and neither can those
+  // before it
+  h.begin();
+  h.add(undo::op::insertText, 0, 0, std::string(limit + 1, 'x'));
+  CHECK(h.size() == 0);
+  CHECK(h.undo().empty());
+  h.begin();
+  h.add(undo::op::insertText, 0, 0, "y");
+  CHECK(h.undo().size() == 1);
+}